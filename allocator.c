@@ -3,7 +3,11 @@
 #include <sys/types.h>
 #include <string.h>  // For memcpy
 #include <stdint.h>  // For SIZE_MAX
+#include <sys/mman.h>  // For mmap, madvise
 #include "block_meta.h"
+#include "heap_stats.h"
+#include "profiler.h"
+#include "guarded_pool.h"
 
 
 // typedef struct block_meta {
@@ -16,27 +20,362 @@
 // Global base for the free list
 block_meta *global_base = NULL;  // Head of the free list
 block_meta *last_alloc = NULL;   // Pointer to the last allocated block
+block_meta *list_tail = NULL;    // Last block appended; the real tail is here or after it (splits)
 
 
 
-size_t calculate_usable_memory() {
-    size_t total_free_memory = 0;
-    block_meta* current = global_base;
+// Heap Statistics
+// Updated at every point a block is created, split, reused or freed so that
+// heap_stats() is O(1) and never walks the list. largest_free_block is the
+// maximum of the highest non-empty power-of-two range of free blocks. It is
+// exact unless the largest block of that range was handed out while smaller
+// ones remain; until a bigger one is freed it then reports the range's lower
+// bound, which is within a factor of two.
 
-    while (current != NULL) {
-        if (current->free) {
-            total_free_memory += current->size;
-        }
-        current = current->next;
+#define STATS_SIZE_RANGES 64
+
+heap_info stats;
+size_t stats_range_count[STATS_SIZE_RANGES];      // Free blocks in [2^r, 2^(r+1))
+size_t stats_range_max[STATS_SIZE_RANGES];        // Largest free block in the range
+size_t stats_range_max_count[STATS_SIZE_RANGES];  // Free blocks known to have that size
+uint64_t stats_nonempty_ranges = 0;               // Bit r set while range r has free blocks
+
+void huge_page_untrim(block_meta* block);
+void adaptive_reset();
+
+int stats_size_class(size_t size) {
+    if (size <= 16) {
+        return 0;
     }
+    int class = 64 - __builtin_clzl(size - 1) - 4;  // <= 16 << class
+    return class < HEAP_STATS_CLASSES - 1 ? class : HEAP_STATS_CLASSES - 1;
+}
+
+int stats_size_range(size_t size) {
+    return 63 - __builtin_clzl(size | 1);
+}
+
+void stats_add_free(size_t size) {
+    stats.free_bytes += size;
+    stats.free_blocks++;
+    stats.free_by_class[stats_size_class(size)]++;
+
+    int range = stats_size_range(size);
+    stats_range_count[range]++;
+    stats_nonempty_ranges |= (uint64_t)1 << range;
+    if (size > stats_range_max[range]) {
+        stats_range_max[range] = size;
+        stats_range_max_count[range] = 1;
+    } else if (size == stats_range_max[range]) {
+        stats_range_max_count[range]++;
+    }
+}
 
-    return total_free_memory;
+void stats_remove_free(size_t size) {
+    stats.free_bytes -= size;
+    stats.free_blocks--;
+    stats.free_by_class[stats_size_class(size)]--;
+
+    int range = stats_size_range(size);
+    if (--stats_range_count[range] == 0) {
+        stats_nonempty_ranges &= ~((uint64_t)1 << range);
+        stats_range_max[range] = 0;
+        stats_range_max_count[range] = 0;
+    } else if (size == stats_range_max[range] && stats_range_max_count[range]
+               && --stats_range_max_count[range] == 0) {
+        stats_range_max[range] = (size_t)1 << range;  // Lower bound until a larger block is freed
+    }
+}
+
+void stats_add_allocated(size_t size) {
+    stats.allocated_bytes += size;
+    stats.allocated_blocks++;
+    stats.allocated_by_class[stats_size_class(size)]++;
+    if (stats.allocated_bytes > stats.peak_allocated_bytes) {
+        stats.peak_allocated_bytes = stats.allocated_bytes;
+    }
+}
+
+void stats_remove_allocated(size_t size) {
+    stats.allocated_bytes -= size;
+    stats.allocated_blocks--;
+    stats.allocated_by_class[stats_size_class(size)]--;
+}
+
+// A block obtained from request_heap_space joined the list already allocated
+void stats_block_created(block_meta* block) {
+    stats.heap_bytes += block->size + sizeof(block_meta);
+    stats_add_allocated(block->size);
+}
+
+// A free block found by a search is being handed out
+void stats_block_reused(block_meta* block) {
+    huge_page_untrim(block);
+    stats_remove_free(block->size);
+    stats_add_allocated(block->size);
+}
+
+void stats_block_freed(block_meta* block) {
+    stats_remove_allocated(block->size);
+    stats_add_free(block->size);
+}
+
+size_t thp_reserved_total();
+
+heap_info heap_stats() {
+    stats.largest_free_block = stats_nonempty_ranges
+        ? stats_range_max[63 - __builtin_clzll(stats_nonempty_ranges)]
+        : 0;
+    stats.mmap_bytes = thp_reserved_total();
+    return stats;
+}
+
+// 0 when all free memory is in one block, approaching 1 as it splinters
+double heap_fragmentation_index() {
+    heap_info info = heap_stats();
+    if (info.free_bytes == 0) {
+        return 0;
+    }
+    return 1.0 - (double)info.largest_free_block / info.free_bytes;
+}
+
+size_t calculate_usable_memory() {
+    return stats.free_bytes;
 }
 
 void reset_memory_tracking() {
     global_base = NULL;
     last_alloc = NULL;
-    // Add any additional cleanup needed for other global tracking variables
+    list_tail = NULL;
+
+    // Blocks of the old list are abandoned, only the process totals survive
+    size_t sbrk_bytes = stats.sbrk_bytes;
+    memset(&stats, 0, sizeof(stats));
+    stats.sbrk_bytes = sbrk_bytes;
+    memset(stats_range_count, 0, sizeof(stats_range_count));
+    memset(stats_range_max, 0, sizeof(stats_range_max));
+    memset(stats_range_max_count, 0, sizeof(stats_range_max_count));
+    stats_nonempty_ranges = 0;
+    adaptive_reset();
+}
+
+
+
+
+// Huge Page Arenas
+// When use_huge_pages is set, request_heap_space carves blocks out of 2 MiB
+// aligned mmap arenas advised with MADV_HUGEPAGE instead of moving the
+// program break, so the block list stays packed into as few dTLB entries
+// as possible.
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+#define HUGE_PAGE_ARENA_SIZE (32 * HUGE_PAGE_SIZE)  // Reserved per arena
+#define HUGE_PAGE_SMALL_PAGE ((size_t)4096)
+
+typedef enum huge_page_trim_policy {
+    HUGE_PAGE_TRIM_NEVER,        // Keep every huge page mapped
+    HUGE_PAGE_TRIM_WHOLE_PAGES,  // Release only huge pages fully covered by a free block
+    HUGE_PAGE_TRIM_SPLIT         // Also release 4 KiB runs, breaking huge pages up
+} huge_page_trim_policy;
+
+int use_huge_pages = 0;
+huge_page_trim_policy huge_page_trim_mode = HUGE_PAGE_TRIM_WHOLE_PAGES;
+
+// Every arena starts with one of these, so thp_backed_bytes can tell the
+// arenas' mappings apart from the rest of the process
+typedef struct huge_arena {
+    char* end;
+    struct huge_arena* next;
+} huge_arena;
+
+huge_arena* huge_arenas = NULL;
+char* huge_arena_top = NULL;  // Next free byte in the current arena
+char* huge_arena_end = NULL;  // End of the current arena
+
+size_t thp_reserved_bytes = 0;  // Bytes mapped with MADV_HUGEPAGE
+size_t thp_used_bytes = 0;      // Bytes handed out to blocks
+size_t trimmed_bytes = 0;       // Free block bytes currently given back to the kernel by trimming
+
+// A free block whose pages trim_huge_pages released keeps `free` non-zero, so
+// every search still treats it as free, but records the granule it was
+// trimmed with. A second trim skips it, and handing it out again returns its
+// bytes to the count.
+#define BLOCK_TRIMMED_HUGE 2   // Released in whole huge pages
+#define BLOCK_TRIMMED_SMALL 3  // Released in 4 KiB runs as well
+
+void set_huge_pages(int enabled) {
+    use_huge_pages = enabled;
+}
+
+void set_huge_page_trim_policy(huge_page_trim_policy policy) {
+    huge_page_trim_mode = policy;
+}
+
+int huge_arena_contains(size_t address) {
+    for (huge_arena* arena = huge_arenas; arena; arena = arena->next) {
+        if (address >= (size_t)arena && address < (size_t)arena->end) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Bytes of the arenas the kernel actually backs with huge pages, from the
+// AnonHugePages lines of /proc/self/smaps. MADV_HUGEPAGE is only a hint:
+// khugepaged may not have collapsed a range yet, and a split trim breaks
+// huge pages up. Reads a procfs file, so it is for reporting, not hot paths.
+size_t thp_backed_bytes() {
+    if (!huge_arenas) {
+        return 0;
+    }
+
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps) {
+        return 0;
+    }
+
+    char line[256];
+    size_t backed = 0;
+    int in_arena = 0;
+    while (fgets(line, sizeof(line), smaps)) {
+        size_t start, end, kb;
+        if (sscanf(line, "%zx-%zx ", &start, &end) == 2) {
+            in_arena = huge_arena_contains(start);  // A new mapping starts here
+        } else if (in_arena && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            backed += kb * 1024;
+        }
+    }
+
+    fclose(smaps);
+    return backed;
+}
+
+size_t thp_allocated_bytes() {
+    return thp_used_bytes;
+}
+
+size_t thp_released_bytes() {
+    return trimmed_bytes;
+}
+
+size_t thp_reserved_total() {
+    return thp_reserved_bytes;
+}
+
+// Bytes of whole `granule` pages inside the payload of `block`
+size_t trimmable_bytes(block_meta* block, size_t granule) {
+    size_t start = round_up((size_t)(block + 1), granule);
+    size_t end = ((size_t)(block + 1) + block->size) & ~(granule - 1);
+    return end > start ? end - start : 0;
+}
+
+// A free block is being reused or split: its pages will be faulted back in.
+// Must run before the block's size or `free` changes.
+void huge_page_untrim(block_meta* block) {
+    if (block->free > 1) {
+        size_t granule = block->free == BLOCK_TRIMMED_SMALL ? HUGE_PAGE_SMALL_PAGE : HUGE_PAGE_SIZE;
+        trimmed_bytes -= trimmable_bytes(block, granule);
+        block->free = 1;
+    }
+}
+
+// Map a huge page aligned arena of at least `size` bytes.
+int reserve_huge_arena(size_t size) {
+    size_t arena_size = round_up(size, HUGE_PAGE_SIZE);
+    if (arena_size < HUGE_PAGE_ARENA_SIZE) {
+        arena_size = HUGE_PAGE_ARENA_SIZE;
+    }
+
+    // Over-map by one huge page so the start can be aligned, then drop the slack
+    size_t map_size = arena_size + HUGE_PAGE_SIZE;
+    char* raw = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return 0;
+    }
+
+    char* aligned = (char*)round_up((size_t)raw, HUGE_PAGE_SIZE);
+    size_t head = aligned - raw;
+    size_t tail = map_size - head - arena_size;
+    if (head) {
+        munmap(raw, head);
+    }
+    if (tail) {
+        munmap(aligned + arena_size, tail);
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, arena_size, MADV_HUGEPAGE);
+#endif
+
+    huge_arena* arena = (huge_arena*)aligned;
+    arena->end = aligned + arena_size;
+    arena->next = huge_arenas;
+    huge_arenas = arena;
+
+    huge_arena_top = aligned + round_up(sizeof(huge_arena), sizeof(void*));
+    huge_arena_end = aligned + arena_size;
+    thp_reserved_bytes += arena_size;
+    return 1;
+}
+
+// Bump-allocate from the current arena. Blocks are only pointer aligned so
+// small objects stay dense inside each huge page.
+void* huge_page_carve(size_t total_size) {
+    total_size = round_up(total_size, sizeof(void*));
+
+    if (!huge_arena_top || (size_t)(huge_arena_end - huge_arena_top) < total_size) {
+        if (!reserve_huge_arena(total_size)) {
+            return NULL;
+        }
+    }
+
+    void* block = huge_arena_top;
+    huge_arena_top += total_size;
+    thp_used_bytes += total_size;
+    return block;
+}
+
+// Grow the heap by `total_size` bytes from sbrk or from a huge page arena.
+void* request_heap_space(size_t total_size) {
+    if (use_huge_pages) {
+        return huge_page_carve(total_size);
+    }
+
+    void* block = sbrk(total_size);
+    if (block == (void*) -1) {
+        return NULL;
+    }
+    stats.sbrk_bytes += total_size;
+    return block;
+}
+
+// Hand the pages behind free blocks back to the kernel according to
+// huge_page_trim_mode. Block headers are never touched, so free blocks stay
+// usable; their payload simply reads back as zeroes once faulted in again.
+size_t trim_huge_pages() {
+    if (huge_page_trim_mode == HUGE_PAGE_TRIM_NEVER) {
+        return 0;
+    }
+
+    size_t granule = huge_page_trim_mode == HUGE_PAGE_TRIM_SPLIT ? HUGE_PAGE_SMALL_PAGE : HUGE_PAGE_SIZE;
+    int state = huge_page_trim_mode == HUGE_PAGE_TRIM_SPLIT ? BLOCK_TRIMMED_SMALL : BLOCK_TRIMMED_HUGE;
+    size_t released = 0;
+    block_meta* current = global_base;
+
+    while (current != NULL) {
+        if (current->free == 1) {  // Free and not trimmed yet
+            size_t bytes = trimmable_bytes(current, granule);
+            size_t start = round_up((size_t)(current + 1), granule);
+            if (bytes && madvise((void*)start, bytes, MADV_DONTNEED) == 0) {
+                released += bytes;
+                current->free = state;
+            }
+        }
+        current = current->next;
+    }
+
+    trimmed_bytes += released;
+    return released;
 }
 
 
@@ -55,20 +394,33 @@ block_meta* find_first_fit(size_t size) {
     return NULL;  // No suitable block found
 }
 
+// Link a new block at the real end of the list so every strategy's search can
+// reach it again once it is freed.
+void append_block(block_meta* block) {
+    if (!global_base) {
+        global_base = block;
+    } else {
+        block_meta* last = list_tail ? list_tail : global_base;
+        while (last->next) {  // Only blocks split off since the last append
+            last = last->next;
+        }
+        last->next = block;
+    }
+    list_tail = block;
+}
+
 block_meta* request_space_first_fit(block_meta* last, size_t size) {
-    block_meta* block = sbrk(size + sizeof(block_meta));
-    if (block == (void*) -1) {
-        return NULL; // sbrk failed, no memory allocated
+    block_meta* block = request_heap_space(size + sizeof(block_meta));
+    if (!block) {
+        return NULL; // sbrk or mmap failed, no memory allocated
     }
 
     block->size = size;
     block->free = 0;
     block->next = NULL;
 
-    if (last) {  // NULL on the first call to malloc
-        last->next = block;
-    }
-
+    append_block(block);  // `last` is unused: the list tail is tracked globally
+    stats_block_created(block);
     return block;
 }
 
@@ -77,6 +429,14 @@ void* first_fit_alloc(size_t size) {
         return NULL;
     }
 
+    if (GUARDED_SHOULD_SAMPLE()) {
+        void* guarded = guarded_alloc(size);
+        if (guarded) {
+            PROFILE_ALLOC(guarded, size);
+            return guarded;
+        }
+    }
+
     block_meta *block = find_first_fit(size);
     if (!block) {  // No fitting block found, need to request more space
         block = request_space_first_fit(NULL, size);
@@ -84,9 +444,11 @@ void* first_fit_alloc(size_t size) {
             return NULL;  // Failed to request space
         }
     } else {
+        stats_block_reused(block);
         block->free = 0;  // Mark block as not free
     }
 
+    PROFILE_ALLOC(block + 1, size);
     return (block + 1);  // Return a pointer to the usable memory area, skipping the block meta
 }
 
@@ -94,8 +456,17 @@ void first_fit_free(void* ptr) {
     if (!ptr) {
         return;
     }
+    PROFILE_FREE(ptr);
+    if (GUARDED_OWNS(ptr)) {
+        guarded_free(ptr);
+        return;
+    }
 
     block_meta* block_ptr = (block_meta*)ptr - 1;
+    if (block_ptr->free) {
+        return;  // Double free
+    }
+    stats_block_freed(block_ptr);
     block_ptr->free = 1;
 
     // Optional: Coalesce free blocks here
@@ -123,19 +494,17 @@ block_meta* find_worst_fit(size_t size) {
 }
 
 block_meta* request_space_worst_fit(block_meta* last, size_t size) {
-    block_meta* block = sbrk(size + sizeof(block_meta));
-    if (block == (void*) -1) {
-        return NULL; // sbrk failed, no memory allocated
+    block_meta* block = request_heap_space(size + sizeof(block_meta));
+    if (!block) {
+        return NULL; // sbrk or mmap failed, no memory allocated
     }
 
     block->size = size;
     block->free = 0;
     block->next = NULL;
 
-    if (last) {  // Link the new block to the last block in the list
-        last->next = block;
-    }
-
+    append_block(block);  // `last` is unused: the list tail is tracked globally
+    stats_block_created(block);
     return block;
 }
 
@@ -145,6 +514,14 @@ void* worst_fit_alloc(size_t size) {
         return NULL;
     }
 
+    if (GUARDED_SHOULD_SAMPLE()) {
+        void* guarded = guarded_alloc(size);
+        if (guarded) {
+            PROFILE_ALLOC(guarded, size);
+            return guarded;
+        }
+    }
+
     block_meta *block = find_worst_fit(size);
     if (!block) {  // No suitable block found, need to request more space
         block = request_space_worst_fit(NULL, size);
@@ -152,9 +529,11 @@ void* worst_fit_alloc(size_t size) {
             return NULL;  // Failed to request space
         }
     } else {
+        stats_block_reused(block);
         block->free = 0;  // Mark block as allocated
     }
 
+    PROFILE_ALLOC(block + 1, size);
     return (block + 1);  // Return a pointer to the usable memory area, skipping the block metadata
 }
 
@@ -162,8 +541,17 @@ void worst_fit_free(void* ptr) {
     if (!ptr) {
         return;
     }
+    PROFILE_FREE(ptr);
+    if (GUARDED_OWNS(ptr)) {
+        guarded_free(ptr);
+        return;
+    }
 
     block_meta* block_ptr = (block_meta*)ptr - 1;
+    if (block_ptr->free) {
+        return;  // Double free
+    }
+    stats_block_freed(block_ptr);
     block_ptr->free = 1;
 
     // Optional: Coalesce free blocks here
@@ -175,6 +563,9 @@ void worst_fit_free(void* ptr) {
 
 // Next Fit Algorithm
 block_meta* find_next_fit(size_t size) {
+    if (!global_base) {  // Empty list, e.g. right after reset_memory_tracking
+        return NULL;
+    }
     block_meta *start = last_alloc ? last_alloc->next : global_base;
 
     // First, try to find a block starting from last_alloc
@@ -194,22 +585,18 @@ block_meta* find_next_fit(size_t size) {
 }
 
 block_meta* request_space_next_fit(block_meta* last, size_t size) {
-    block_meta* block = sbrk(size + sizeof(block_meta));
-    if (block == (void*) -1) {
-        return NULL; // sbrk failed, no memory allocated
+    block_meta* block = request_heap_space(size + sizeof(block_meta));
+    if (!block) {
+        return NULL; // sbrk or mmap failed, no memory allocated
     }
 
     block->size = size;
     block->free = 0;
     block->next = NULL;
 
-    if (last) {  // Link the new block to the last block in the list
-        last->next = block;
-    } else {  // No blocks have been allocated yet
-        global_base = block;
-    }
-
+    append_block(block);  // At the tail: linking after `last` would cut off the rest of the list
     last_alloc = block;  // Update last_alloc to the newly created block
+    stats_block_created(block);
     return block;
 }
 
@@ -219,6 +606,14 @@ void* next_fit_alloc(size_t size) {
         return NULL;
     }
 
+    if (GUARDED_SHOULD_SAMPLE()) {
+        void* guarded = guarded_alloc(size);
+        if (guarded) {
+            PROFILE_ALLOC(guarded, size);
+            return guarded;
+        }
+    }
+
     block_meta *block = find_next_fit(size);
     if (!block) {  // No suitable block found, need to request more space
         block = request_space_next_fit(last_alloc, size);
@@ -226,9 +621,11 @@ void* next_fit_alloc(size_t size) {
             return NULL;  // Failed to request space
         }
     } else {
+        stats_block_reused(block);
         block->free = 0;  // Mark block as allocated
     }
 
+    PROFILE_ALLOC(block + 1, size);
     return (block + 1);  // Return a pointer to the usable memory area, skipping the block metadata
 }
 
@@ -236,8 +633,17 @@ void next_fit_free(void* ptr) {
     if (!ptr) {
         return;
     }
+    PROFILE_FREE(ptr);
+    if (GUARDED_OWNS(ptr)) {
+        guarded_free(ptr);
+        return;
+    }
 
     block_meta* block_ptr = (block_meta*)ptr - 1;
+    if (block_ptr->free) {
+        return;  // Double free
+    }
+    stats_block_freed(block_ptr);
     block_ptr->free = 1;
 
     // Optional: Coalesce free blocks here
@@ -264,13 +670,18 @@ block_meta* find_best_fit(block_meta **last, size_t size) {
     return best_fit;
 }
 
+// `block` must still be free; both halves stay free
 void split_block(block_meta* block, size_t size) {
     block_meta* new_block = (block_meta*)((char*)block + size + sizeof(block_meta));
+    huge_page_untrim(block);  // Both halves count as untrimmed until the next trim
+    stats_remove_free(block->size);
     new_block->size = block->size - size - sizeof(block_meta);
     new_block->free = 1;
     new_block->next = block->next;
     block->size = size;
     block->next = new_block;
+    stats_add_free(block->size);
+    stats_add_free(new_block->size);
 }
 
 block_meta* find_free_block(block_meta **last, size_t size) {
@@ -285,10 +696,10 @@ block_meta* find_free_block(block_meta **last, size_t size) {
 block_meta* request_space_best_fit(block_meta* last, size_t size) {
     // Adjust size to include the metadata structure
     size_t total_size = size + sizeof(block_meta);
-    // Use sbrk to request memory: move the program break
-    block_meta* block = sbrk(total_size);
-    if (block == (void*) -1) {
-        return NULL; // sbrk failed, no memory allocated
+    // Move the program break, or carve from a huge page arena
+    block_meta* block = request_heap_space(total_size);
+    if (!block) {
+        return NULL; // sbrk or mmap failed, no memory allocated
     }
 
     // If there's a last block, update its 'next' pointer
@@ -300,6 +711,7 @@ block_meta* request_space_best_fit(block_meta* last, size_t size) {
     block->size = size;
     block->next = NULL;
     block->free = 0;  // Mark as allocated
+    stats_block_created(block);
 
     return block;
 }
@@ -311,6 +723,14 @@ void* best_fit_alloc(size_t size) {
         return NULL;
     }
 
+    if (GUARDED_SHOULD_SAMPLE()) {
+        void* guarded = guarded_alloc(size);
+        if (guarded) {
+            PROFILE_ALLOC(guarded, size);
+            return guarded;
+        }
+    }
+
     if (!global_base) { // First call
         block = request_space_best_fit(NULL, size);
         if (!block) {
@@ -330,9 +750,11 @@ void* best_fit_alloc(size_t size) {
             if (block->size > size + sizeof(block_meta) + 4) { // Threshold of 4 bytes
                 split_block(block, size);
             }
+            stats_block_reused(block);
             block->free = 0;
         }
     }
+    PROFILE_ALLOC(block + 1, size);
     return (block+1);
 }
 
@@ -341,8 +763,17 @@ void best_fit_free(void* ptr) {
     if (!ptr) {
         return;
     }
+    PROFILE_FREE(ptr);
+    if (GUARDED_OWNS(ptr)) {
+        guarded_free(ptr);
+        return;
+    }
 
     block_meta* block_ptr = (block_meta*)ptr - 1;
+    if (block_ptr->free) {
+        return;  // Double free
+    }
+    stats_block_freed(block_ptr);
     block_ptr->free = 1;
 
     // Optional: Coalesce free blocks here
@@ -350,6 +781,285 @@ void best_fit_free(void* ptr) {
 
 
 
+// Adaptive Fit Algorithm
+// Keeps a placement policy per size class and re-evaluates it every
+// ADAPTIVE_WINDOW allocations from the statistics gathered in that window.
+
+#define ADAPTIVE_SIZE_CLASSES 4     // <= 64, <= 512, <= 4096 and larger
+#define ADAPTIVE_WINDOW 1024        // Allocations per evaluation window
+#define ADAPTIVE_MIN_SAMPLES 64     // Classes seen less often keep their policy
+#define ADAPTIVE_DEEP_SEARCH 64     // Average blocks visited that counts as slow
+#define ADAPTIVE_HIGH_FRAG 0.5      // Share of the heap sitting in free blocks
+#define ADAPTIVE_LOW_FRAG 0.25
+#define ADAPTIVE_HIGH_MISS 0.25     // Share of allocations that had to grow the heap
+#define ADAPTIVE_WIDE_SPREAD 16     // Largest / smallest request in a class
+#define ADAPTIVE_SWITCH_WINDOWS 3   // Consecutive windows a new policy must win
+#define ADAPTIVE_DEPTH_MEMORY 64    // Windows a policy's measured depth is trusted
+
+typedef enum fit_policy {
+    FIT_FIRST,
+    FIT_NEXT,
+    FIT_BEST,
+    FIT_WORST
+} fit_policy;
+
+const char* fit_policy_names[] = {"First Fit", "Next Fit", "Best Fit", "Worst Fit"};
+const size_t adaptive_class_limits[ADAPTIVE_SIZE_CLASSES] = {64, 512, 4096, SIZE_MAX};
+
+typedef struct adaptive_window {
+    size_t allocations;
+    size_t requested_bytes;
+    size_t min_request;
+    size_t max_request;
+    size_t search_steps;   // Blocks visited by the policy's search
+    size_t heap_grows;     // Allocations no free block could satisfy
+} adaptive_window;
+
+fit_policy adaptive_policy[ADAPTIVE_SIZE_CLASSES];  // Zero-initialised to FIT_FIRST
+adaptive_window adaptive_stats[ADAPTIVE_SIZE_CLASSES];
+size_t adaptive_window_allocations = 0;
+
+// A class only switches once the same candidate has won ADAPTIVE_SWITCH_WINDOWS
+// evaluations in a row, and never to a policy whose own recent windows searched
+// deeper than the current one, so it cannot flip back and forth every window.
+fit_policy adaptive_candidate[ADAPTIVE_SIZE_CLASSES];
+int adaptive_streak[ADAPTIVE_SIZE_CLASSES];
+double adaptive_depth[ADAPTIVE_SIZE_CLASSES][4];    // Average depth each policy achieved
+int adaptive_depth_age[ADAPTIVE_SIZE_CLASSES][4];   // Windows since measured, 0 if never
+
+block_meta* adaptive_cursor = NULL;  // Roving pointer for next fit
+FILE* adaptive_log = NULL;  // Decisions go to stderr unless redirected
+
+void set_adaptive_log(FILE* file) {
+    adaptive_log = file;
+}
+
+// The list was abandoned by reset_memory_tracking. Everything learned about
+// it goes too, so each run starts from First Fit in every class and runs
+// measured back to back are independent.
+void adaptive_reset() {
+    adaptive_cursor = NULL;
+    adaptive_window_allocations = 0;
+    memset(adaptive_policy, 0, sizeof(adaptive_policy));
+    memset(adaptive_stats, 0, sizeof(adaptive_stats));
+    memset(adaptive_candidate, 0, sizeof(adaptive_candidate));
+    memset(adaptive_streak, 0, sizeof(adaptive_streak));
+    memset(adaptive_depth, 0, sizeof(adaptive_depth));
+    memset(adaptive_depth_age, 0, sizeof(adaptive_depth_age));
+}
+
+int adaptive_size_class(size_t size) {
+    int class = 0;
+    while (size > adaptive_class_limits[class]) {
+        class++;
+    }
+    return class;
+}
+
+block_meta* adaptive_find(fit_policy policy, size_t size, size_t* steps) {
+    block_meta* current;
+    block_meta* chosen = NULL;
+
+    switch (policy) {
+    case FIT_NEXT:
+        current = adaptive_cursor ? adaptive_cursor : global_base;
+        for (block_meta* start = current; current; ) {
+            (*steps)++;
+            if (current->free && current->size >= size) {
+                adaptive_cursor = current->next;
+                return current;
+            }
+            current = current->next ? current->next : global_base;
+            if (current == start) {
+                break;
+            }
+        }
+        return NULL;
+
+    case FIT_BEST:
+    case FIT_WORST:
+        for (current = global_base; current; current = current->next) {
+            (*steps)++;
+            if (!current->free || current->size < size) {
+                continue;
+            }
+            if (!chosen
+                || (policy == FIT_BEST && current->size < chosen->size)
+                || (policy == FIT_WORST && current->size > chosen->size)) {
+                chosen = current;
+                if (policy == FIT_BEST && current->size == size) {
+                    break;  // Exact fit, nothing better to find
+                }
+            }
+        }
+        return chosen;
+
+    case FIT_FIRST:
+    default:
+        for (current = global_base; current; current = current->next) {
+            (*steps)++;
+            if (current->free && current->size >= size) {
+                return current;
+            }
+        }
+        return NULL;
+    }
+}
+
+// True when `policy` was measured recently and searched deeper than `depth`
+int adaptive_measured_deeper(int class, fit_policy policy, double depth) {
+    int age = adaptive_depth_age[class][policy];
+    return age > 0 && age <= ADAPTIVE_DEPTH_MEMORY && adaptive_depth[class][policy] > depth;
+}
+
+fit_policy adaptive_choose_policy(int class, adaptive_window* window, fit_policy current) {
+    double avg_depth = (double)window->search_steps / window->allocations;
+    double miss_rate = (double)window->heap_grows / window->allocations;
+    double frag = stats.heap_bytes ? (double)stats.free_bytes / stats.heap_bytes : 0;
+    size_t spread = window->max_request / (window->min_request ? window->min_request : 1);
+
+    if (frag > ADAPTIVE_HIGH_FRAG && miss_rate > ADAPTIVE_HIGH_MISS) {
+        return FIT_BEST;   // Plenty of free memory but nothing fits: pack tighter
+    }
+    if (spread >= ADAPTIVE_WIDE_SPREAD && miss_rate > ADAPTIVE_HIGH_MISS && frag >= ADAPTIVE_LOW_FRAG) {
+        return FIT_WORST;  // Mixed sizes: carve from the largest hole to keep remainders usable
+    }
+    if (avg_depth > ADAPTIVE_DEEP_SEARCH && frag < ADAPTIVE_LOW_FRAG
+        && !adaptive_measured_deeper(class, FIT_NEXT, avg_depth)) {
+        return FIT_NEXT;   // Searches are long and memory is tight anyway: favour speed
+    }
+    if (avg_depth <= ADAPTIVE_DEEP_SEARCH && frag < ADAPTIVE_LOW_FRAG
+        && !adaptive_measured_deeper(class, FIT_FIRST, avg_depth)) {
+        return FIT_FIRST;
+    }
+    return current;
+}
+
+void adaptive_evaluate() {
+    for (int class = 0; class < ADAPTIVE_SIZE_CLASSES; class++) {
+        adaptive_window* window = &adaptive_stats[class];
+        if (window->allocations >= ADAPTIVE_MIN_SAMPLES) {
+            fit_policy current = adaptive_policy[class];
+            for (int policy = 0; policy < 4; policy++) {
+                if (adaptive_depth_age[class][policy]) {
+                    adaptive_depth_age[class][policy]++;
+                }
+            }
+            adaptive_depth[class][current] = (double)window->search_steps / window->allocations;
+            adaptive_depth_age[class][current] = 1;
+
+            fit_policy next = adaptive_choose_policy(class, window, current);
+            if (next == current) {
+                adaptive_streak[class] = 0;
+            } else if (next == adaptive_candidate[class] && adaptive_streak[class] > 0) {
+                adaptive_streak[class]++;
+            } else {
+                adaptive_candidate[class] = next;
+                adaptive_streak[class] = 1;
+            }
+
+            if (adaptive_streak[class] >= ADAPTIVE_SWITCH_WINDOWS) {
+                fprintf(adaptive_log ? adaptive_log : stderr,
+                        "adaptive: class %d (requests %zu-%zu bytes) %s -> %s: allocs=%zu mean=%zu "
+                        "avg_depth=%.1f miss=%.2f frag=%.2f free_blocks=%zu\n",
+                        class, window->min_request, window->max_request,
+                        fit_policy_names[adaptive_policy[class]], fit_policy_names[next],
+                        window->allocations, window->requested_bytes / window->allocations,
+                        (double)window->search_steps / window->allocations,
+                        (double)window->heap_grows / window->allocations,
+                        stats.heap_bytes ? (double)stats.free_bytes / stats.heap_bytes : 0,
+                        stats.free_blocks);
+                adaptive_policy[class] = next;
+                adaptive_streak[class] = 0;
+            }
+        }
+        memset(window, 0, sizeof(*window));
+    }
+    adaptive_window_allocations = 0;
+}
+
+block_meta* request_space_adaptive(size_t size) {
+    block_meta* block = request_heap_space(size + sizeof(block_meta));
+    if (!block) {
+        return NULL;
+    }
+
+    block->size = size;
+    block->free = 0;
+    block->next = NULL;
+
+    append_block(block);
+    stats_block_created(block);
+    return block;
+}
+
+void* adaptive_alloc(size_t size) {
+    if (size <= 0) {
+        return NULL;
+    }
+
+    if (GUARDED_SHOULD_SAMPLE()) {
+        void* guarded = guarded_alloc(size);
+        if (guarded) {
+            PROFILE_ALLOC(guarded, size);
+            return guarded;
+        }
+    }
+
+    int class = adaptive_size_class(size);
+    adaptive_window* window = &adaptive_stats[class];
+    if (window->allocations == 0 || size < window->min_request) {
+        window->min_request = size;
+    }
+    if (size > window->max_request) {
+        window->max_request = size;
+    }
+    window->allocations++;
+    window->requested_bytes += size;
+
+    block_meta* block = adaptive_find(adaptive_policy[class], size, &window->search_steps);
+    if (!block) {
+        window->heap_grows++;
+        block = request_space_adaptive(size);
+        if (!block) {
+            return NULL;
+        }
+    } else {
+        if (block->size > size + sizeof(block_meta) + 4) {
+            split_block(block, size);
+        }
+        stats_block_reused(block);
+        block->free = 0;
+    }
+
+    if (++adaptive_window_allocations >= ADAPTIVE_WINDOW) {
+        adaptive_evaluate();
+    }
+
+    PROFILE_ALLOC(block + 1, size);
+    return (block + 1);
+}
+
+void adaptive_free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    PROFILE_FREE(ptr);
+    if (GUARDED_OWNS(ptr)) {
+        guarded_free(ptr);
+        return;
+    }
+
+    block_meta* block_ptr = (block_meta*)ptr - 1;
+    if (block_ptr->free) {
+        return;  // Double free
+    }
+    stats_block_freed(block_ptr);
+    block_ptr->free = 1;
+}
+
+
+
 // void* my_realloc(void* ptr, size_t size) {
 //     if (size == 0) {
 //         my_free(ptr);
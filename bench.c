@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "bench.h"
+
+
+pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+int bench_rows = 0;
+
+
+// Allocator Calls
+// The fit allocators keep their block list in globals with no locking, so
+// calls into them are serialised; thread-safe allocators are called directly.
+
+void* bench_alloc(Allocator* allocator, size_t size) {
+    if (allocator->thread_safe) {
+        return allocator->alloc(size);
+    }
+
+    pthread_mutex_lock(&bench_lock);
+    void* ptr = allocator->alloc(size);
+    pthread_mutex_unlock(&bench_lock);
+    return ptr;
+}
+
+void bench_free(Allocator* allocator, void* ptr) {
+    if (allocator->thread_safe) {
+        allocator->free(ptr);
+        return;
+    }
+
+    pthread_mutex_lock(&bench_lock);
+    allocator->free(ptr);
+    pthread_mutex_unlock(&bench_lock);
+}
+
+double bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+long bench_count(const bench_config* config, long base) {
+    long count = (long)(base * config->scale);
+    return count > 0 ? count : 1;
+}
+
+void bench_run_threads(void* (*thread)(void*), void* args, size_t arg_size, int count) {
+    pthread_t threads[count];
+    for (int i = 0; i < count; i++) {
+        pthread_create(&threads[i], NULL, thread, (char*)args + i * arg_size);
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+
+
+// Larson
+// Server simulation: each thread keeps a set of live objects and keeps
+// replacing random ones. After every round the sets are handed to a new
+// generation of threads, so most objects are freed by a thread other than
+// the one that allocated them.
+
+#define LARSON_SLOTS 1000
+#define LARSON_ROUNDS 4
+#define LARSON_MIN_SIZE 16
+#define LARSON_MAX_SIZE 256
+
+typedef struct larson_thread {
+    Allocator* allocator;
+    void** slots;
+    long operations;
+    unsigned seed;
+} larson_thread;
+
+void* larson_thread_func(void* arg) {
+    larson_thread* t = arg;
+    for (long i = 0; i < t->operations; i++) {
+        int slot = rand_r(&t->seed) % LARSON_SLOTS;
+        bench_free(t->allocator, t->slots[slot]);
+        t->slots[slot] = bench_alloc(t->allocator, LARSON_MIN_SIZE + rand_r(&t->seed) % (LARSON_MAX_SIZE - LARSON_MIN_SIZE));
+    }
+    return NULL;
+}
+
+double larson_workload(Allocator* allocator, const bench_config* config, unsigned seed) {
+    int threads = config->threads;
+    larson_thread args[threads];
+    void** sets[threads];
+
+    for (int i = 0; i < threads; i++) {
+        sets[i] = malloc(LARSON_SLOTS * sizeof(void*));
+        for (int j = 0; j < LARSON_SLOTS; j++) {
+            sets[i][j] = bench_alloc(allocator, LARSON_MIN_SIZE + rand_r(&seed) % (LARSON_MAX_SIZE - LARSON_MIN_SIZE));
+        }
+    }
+
+    long operations = bench_count(config, 100000);
+    double start = bench_now();
+    for (int round = 0; round < LARSON_ROUNDS; round++) {
+        for (int i = 0; i < threads; i++) {
+            args[i].allocator = allocator;
+            args[i].slots = sets[(i + round) % threads];  // Inherit another thread's objects
+            args[i].operations = operations;
+            args[i].seed = seed + round * threads + i;
+        }
+        bench_run_threads(larson_thread_func, args, sizeof(larson_thread), threads);
+    }
+    double elapsed = bench_now() - start;
+
+    for (int i = 0; i < threads; i++) {
+        for (int j = 0; j < LARSON_SLOTS; j++) {
+            bench_free(allocator, sets[i][j]);
+        }
+        free(sets[i]);
+    }
+
+    return 2.0 * operations * threads * LARSON_ROUNDS / elapsed;
+}
+
+
+
+// Threadtest
+// Every thread repeatedly allocates a batch of same-sized objects and then
+// frees the whole batch.
+
+#define THREADTEST_BATCH 1000
+#define THREADTEST_SIZE 64
+
+typedef struct threadtest_thread {
+    Allocator* allocator;
+    long iterations;
+} threadtest_thread;
+
+void* threadtest_thread_func(void* arg) {
+    threadtest_thread* t = arg;
+    void* batch[THREADTEST_BATCH];
+    for (long i = 0; i < t->iterations; i++) {
+        for (int j = 0; j < THREADTEST_BATCH; j++) {
+            batch[j] = bench_alloc(t->allocator, THREADTEST_SIZE);
+        }
+        for (int j = 0; j < THREADTEST_BATCH; j++) {
+            bench_free(t->allocator, batch[j]);
+        }
+    }
+    return NULL;
+}
+
+double threadtest_workload(Allocator* allocator, const bench_config* config, unsigned seed) {
+    int threads = config->threads;
+    threadtest_thread args[threads];
+    long iterations = bench_count(config, 100);
+    (void)seed;  // Fully deterministic
+
+    for (int i = 0; i < threads; i++) {
+        args[i].allocator = allocator;
+        args[i].iterations = iterations;
+    }
+
+    double start = bench_now();
+    bench_run_threads(threadtest_thread_func, args, sizeof(threadtest_thread), threads);
+    double elapsed = bench_now() - start;
+
+    return 2.0 * THREADTEST_BATCH * iterations * threads / elapsed;
+}
+
+
+
+// Xmalloc
+// Producer threads allocate objects and pass them through a ring to a
+// consumer thread, which frees them: every free is a cross-thread free.
+
+#define XMALLOC_RING 1024
+#define XMALLOC_MIN_SIZE 16
+#define XMALLOC_MAX_SIZE 1024
+
+typedef struct xmalloc_pair {
+    Allocator* allocator;
+    long objects;
+    unsigned seed;
+    void* ring[XMALLOC_RING];
+    size_t head;  // Written by the consumer
+    size_t tail;  // Written by the producer
+} xmalloc_pair;
+
+void* xmalloc_producer(void* arg) {
+    xmalloc_pair* pair = arg;
+    for (long i = 0; i < pair->objects; i++) {
+        void* ptr = bench_alloc(pair->allocator, XMALLOC_MIN_SIZE + rand_r(&pair->seed) % (XMALLOC_MAX_SIZE - XMALLOC_MIN_SIZE));
+        size_t tail = __atomic_load_n(&pair->tail, __ATOMIC_RELAXED);
+        while (tail - __atomic_load_n(&pair->head, __ATOMIC_ACQUIRE) == XMALLOC_RING) {
+            sched_yield();  // Ring full
+        }
+        pair->ring[tail % XMALLOC_RING] = ptr;
+        __atomic_store_n(&pair->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+void* xmalloc_consumer(void* arg) {
+    xmalloc_pair* pair = arg;
+    for (long i = 0; i < pair->objects; i++) {
+        size_t head = __atomic_load_n(&pair->head, __ATOMIC_RELAXED);
+        while (__atomic_load_n(&pair->tail, __ATOMIC_ACQUIRE) == head) {
+            sched_yield();  // Ring empty
+        }
+        void* ptr = pair->ring[head % XMALLOC_RING];
+        __atomic_store_n(&pair->head, head + 1, __ATOMIC_RELEASE);
+        bench_free(pair->allocator, ptr);
+    }
+    return NULL;
+}
+
+double xmalloc_workload(Allocator* allocator, const bench_config* config, unsigned seed) {
+    int pairs = config->threads / 2 > 0 ? config->threads / 2 : 1;
+    xmalloc_pair* args = calloc(pairs, sizeof(xmalloc_pair));
+    pthread_t producers[pairs];
+    pthread_t consumers[pairs];
+    long objects = bench_count(config, 200000);
+
+    for (int i = 0; i < pairs; i++) {
+        args[i].allocator = allocator;
+        args[i].objects = objects;
+        args[i].seed = seed + i;
+    }
+
+    double start = bench_now();
+    for (int i = 0; i < pairs; i++) {
+        pthread_create(&consumers[i], NULL, xmalloc_consumer, &args[i]);
+        pthread_create(&producers[i], NULL, xmalloc_producer, &args[i]);
+    }
+    for (int i = 0; i < pairs; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    double elapsed = bench_now() - start;
+
+    free(args);
+    return 2.0 * objects * pairs / elapsed;
+}
+
+
+
+// Mixed-Size Churn
+// Random alloc/free over a per-thread live set with a skewed size mix:
+// mostly small objects, some medium, a few large.
+
+#define CHURN_SLOTS 4096
+
+typedef struct churn_thread {
+    Allocator* allocator;
+    long operations;
+    unsigned seed;
+} churn_thread;
+
+size_t churn_size(unsigned* seed) {
+    int bucket = rand_r(seed) % 100;
+    if (bucket < 80) {
+        return 16 + rand_r(seed) % 112;    // 16 - 127
+    }
+    if (bucket < 95) {
+        return 128 + rand_r(seed) % 3968;  // 128 - 4095
+    }
+    return 4096 + rand_r(seed) % 61440;    // 4096 - 65535
+}
+
+void* churn_thread_func(void* arg) {
+    churn_thread* t = arg;
+    void** live = calloc(CHURN_SLOTS, sizeof(void*));
+
+    for (long i = 0; i < t->operations; i++) {
+        int slot = rand_r(&t->seed) % CHURN_SLOTS;
+        if (live[slot]) {
+            bench_free(t->allocator, live[slot]);
+            live[slot] = NULL;
+        } else {
+            live[slot] = bench_alloc(t->allocator, churn_size(&t->seed));
+        }
+    }
+
+    for (int i = 0; i < CHURN_SLOTS; i++) {
+        if (live[i]) {
+            bench_free(t->allocator, live[i]);
+        }
+    }
+    free(live);
+    return NULL;
+}
+
+double churn_workload(Allocator* allocator, const bench_config* config, unsigned seed) {
+    int threads = config->threads;
+    churn_thread args[threads];
+    long operations = bench_count(config, 200000);
+
+    for (int i = 0; i < threads; i++) {
+        args[i].allocator = allocator;
+        args[i].operations = operations;
+        args[i].seed = seed + i;
+    }
+
+    double start = bench_now();
+    bench_run_threads(churn_thread_func, args, sizeof(churn_thread), threads);
+    double elapsed = bench_now() - start;
+
+    return (double)operations * threads / elapsed;
+}
+
+
+
+// Driver
+
+// Two-sided 95% Student t quantiles for 1..30 degrees of freedom
+const double t_quantiles[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+void bench_begin(const bench_config* config) {
+    bench_rows = 0;
+    if (config->format == BENCH_JSON) {
+        fprintf(config->out, "[\n");
+    } else {
+        fprintf(config->out, "phase,allocator,threads,seed,repetitions,mean_ops_per_sec,stddev,ci95_low,ci95_high\n");
+    }
+}
+
+void bench_end(const bench_config* config) {
+    if (config->format == BENCH_JSON) {
+        fprintf(config->out, "%s]\n", bench_rows ? "\n" : "");
+    }
+    fflush(config->out);
+}
+
+int bench_repetitions(const bench_config* config) {
+    if (config->repetitions < 1) {
+        return 1;
+    }
+    return config->repetitions > BENCH_MAX_REPETITIONS ? BENCH_MAX_REPETITIONS : config->repetitions;
+}
+
+// Mean, sample standard deviation and t-based 95% confidence interval
+bench_result bench_summarize(const double* samples, int count) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+
+    double mean = sum / count;
+    double variance = 0;
+    for (int i = 0; i < count; i++) {
+        variance += (samples[i] - mean) * (samples[i] - mean);
+    }
+    double stddev = count > 1 ? sqrt(variance / (count - 1)) : 0;
+    double t = count - 1 > 30 ? 1.960 : count > 1 ? t_quantiles[count - 2] : 0;
+    double margin = t * stddev / sqrt(count);
+
+    bench_result result = {mean, stddev, mean - margin, mean + margin};
+    return result;
+}
+
+void bench_report(const char* phase, Allocator* allocator, const bench_config* config,
+                  int repetitions, bench_result result) {
+    if (config->format == BENCH_JSON) {
+        fprintf(config->out,
+                "%s  {\"phase\": \"%s\", \"allocator\": \"%s\", \"threads\": %d, \"seed\": %u, "
+                "\"repetitions\": %d, \"mean_ops_per_sec\": %.0f, \"stddev\": %.0f, "
+                "\"ci95_low\": %.0f, \"ci95_high\": %.0f}",
+                bench_rows ? ",\n" : "", phase, allocator->name, config->threads, config->seed,
+                repetitions, result.mean, result.stddev, result.ci95_low, result.ci95_high);
+    } else {
+        fprintf(config->out, "%s,%s,%d,%u,%d,%.0f,%.0f,%.0f,%.0f\n", phase, allocator->name,
+                config->threads, config->seed, repetitions, result.mean, result.stddev,
+                result.ci95_low, result.ci95_high);
+    }
+    bench_rows++;
+    fflush(config->out);
+}
+
+bench_result bench_run(const char* phase, Allocator* allocator, bench_workload workload, const bench_config* config) {
+    int repetitions = bench_repetitions(config);
+
+    for (int i = 0; i < config->warmup; i++) {
+        if (config->reset && !allocator->thread_safe) {
+            config->reset();
+        }
+        workload(allocator, config, config->seed + i);
+    }
+
+    double results[BENCH_MAX_REPETITIONS];
+    for (int i = 0; i < repetitions; i++) {
+        if (config->reset && !allocator->thread_safe) {
+            config->reset();  // Every repetition starts from an empty block list
+        }
+        results[i] = workload(allocator, config, config->seed + config->warmup + i);
+    }
+
+    bench_result result = bench_summarize(results, repetitions);
+    bench_report(phase, allocator, config, repetitions, result);
+    return result;
+}
@@ -0,0 +1,66 @@
+// bench.h
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define BENCH_MAX_REPETITIONS 1000
+
+typedef void* (*alloc_func)(size_t size);
+typedef void (*free_func)(void* ptr);
+
+typedef struct Allocator {
+    alloc_func alloc;
+    free_func free;
+    char* name;
+    int thread_safe;  // 0: bench_alloc/bench_free serialise calls behind a lock
+} Allocator;
+
+typedef enum bench_format {
+    BENCH_CSV,
+    BENCH_JSON
+} bench_format;
+
+typedef struct bench_config {
+    unsigned seed;
+    int warmup;        // Untimed runs before the measured repetitions
+    int repetitions;
+    int threads;
+    double scale;      // Multiplier on every workload's operation count
+    bench_format format;
+    FILE* out;
+    void (*reset)();   // Called before each run of a non-thread-safe allocator
+} bench_config;
+
+// A workload runs once and returns allocator operations per second of wall time
+typedef double (*bench_workload)(Allocator* allocator, const bench_config* config, unsigned seed);
+
+typedef struct bench_result {
+    double mean;       // Operations per second over the measured repetitions
+    double stddev;
+    double ci95_low;
+    double ci95_high;
+} bench_result;
+
+void* bench_alloc(Allocator* allocator, size_t size);
+void bench_free(Allocator* allocator, void* ptr);
+double bench_now();
+long bench_count(const bench_config* config, long base);
+
+void bench_begin(const bench_config* config);
+bench_result bench_run(const char* phase, Allocator* allocator, bench_workload workload, const bench_config* config);
+
+// For phases that schedule their own runs, e.g. interleaving variants
+int bench_repetitions(const bench_config* config);
+bench_result bench_summarize(const double* samples, int count);
+void bench_report(const char* phase, Allocator* allocator, const bench_config* config,
+                  int repetitions, bench_result result);
+void bench_end(const bench_config* config);
+
+double larson_workload(Allocator* allocator, const bench_config* config, unsigned seed);
+double threadtest_workload(Allocator* allocator, const bench_config* config, unsigned seed);
+double xmalloc_workload(Allocator* allocator, const bench_config* config, unsigned seed);
+double churn_workload(Allocator* allocator, const bench_config* config, unsigned seed);
+
+#endif // BENCH_H
@@ -10,4 +10,18 @@ typedef struct block_meta {
     struct block_meta* next;
 } block_meta;
 
+// Position-independent block header for heaps that live in a mapping whose
+// address can change between runs or processes. `next` is a byte offset from
+// the start of the mapping; 0 means end of list.
+typedef struct offset_block_meta {
+    size_t size;
+    int free;
+    size_t next;
+} offset_block_meta;
+
+// Round `value` up to a power-of-two `alignment`
+static inline size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 #endif // BLOCK_META_H
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <sys/mman.h>
+#include "block_meta.h"
+#include "guarded_pool.h"
+
+
+#define GUARDED_MAX_FRAMES 16
+#define GUARDED_ALIGNMENT sizeof(void*)
+
+typedef enum guarded_state {
+    SLOT_FREE,       // Never used, or freed and waiting in the reuse queue
+    SLOT_ALLOCATED
+} guarded_state;
+
+typedef struct guarded_slot {
+    guarded_state state;
+    char* ptr;
+    size_t size;
+    int alloc_depth;
+    int free_depth;
+    void* alloc_stack[GUARDED_MAX_FRAMES];
+    void* free_stack[GUARDED_MAX_FRAMES];
+} guarded_slot;
+
+uint32_t guarded_countdown = UINT32_MAX;
+char* guarded_pool_start = NULL;
+char* guarded_pool_end = NULL;
+
+uint32_t guarded_sample_rate = 0;  // 0 disables sampling
+size_t guarded_page_size = 0;
+size_t guarded_slot_count = 0;
+guarded_slot* guarded_slots = NULL;
+uint64_t guarded_rng = 0x2545f4914f6cdd1dULL;
+
+// Free slots in the order they were released. Allocation takes the oldest,
+// so a freed page stays inaccessible for as long as possible.
+size_t* guarded_queue = NULL;
+size_t guarded_queue_head = 0;
+size_t guarded_queue_length = 0;
+
+struct sigaction guarded_previous_action;
+
+
+uint32_t guarded_random() {
+    guarded_rng ^= guarded_rng << 13;
+    guarded_rng ^= guarded_rng >> 7;
+    guarded_rng ^= guarded_rng << 17;
+    return (uint32_t)(guarded_rng >> 32);
+}
+
+void guarded_rearm() {
+    // Jitter by up to half the rate so sampling does not lock onto a fixed pattern
+    guarded_countdown = guarded_sample_rate
+        ? guarded_sample_rate / 2 + guarded_random() % guarded_sample_rate + 1
+        : UINT32_MAX;
+}
+
+// Slot i owns page 2i + 1 of the pool; even pages are guards.
+char* guarded_slot_page(size_t slot) {
+    return guarded_pool_start + (2 * slot + 1) * guarded_page_size;
+}
+
+
+
+// Fault Reporting
+
+void guarded_print_stack(const char* title, void** frames, int depth) {
+    write(STDERR_FILENO, title, strlen(title));
+    backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+}
+
+void guarded_report(char* addr) {
+    size_t page = (addr - guarded_pool_start) / guarded_page_size;
+    size_t slot = page / 2;
+    const char* kind;
+
+    if (page % 2 == 1) {
+        kind = "use-after-free";
+    } else {
+        // A guard page: blame whichever allocated neighbour is closer
+        int has_left = page > 0 && guarded_slots[slot - 1].state == SLOT_ALLOCATED;
+        int has_right = slot < guarded_slot_count && guarded_slots[slot].state == SLOT_ALLOCATED;
+        size_t left_gap = has_left ? addr - (guarded_slots[slot - 1].ptr + guarded_slots[slot - 1].size) : SIZE_MAX;
+        size_t right_gap = has_right ? guarded_slots[slot].ptr - addr : SIZE_MAX;
+
+        if (!has_left && !has_right) {
+            kind = "wild access to guard page";
+            slot = slot < guarded_slot_count ? slot : slot - 1;
+        } else if (left_gap <= right_gap) {
+            kind = "buffer-overflow";
+            slot = slot - 1;
+        } else {
+            kind = "buffer-underflow";
+        }
+    }
+
+    guarded_slot* s = &guarded_slots[slot];
+    char line[256];
+    int len = snprintf(line, sizeof(line),
+                       "guarded_pool: %s at %p, %zu-byte allocation at %p\n",
+                       kind, (void*)addr, s->size, (void*)s->ptr);
+    write(STDERR_FILENO, line, len);
+
+    guarded_print_stack("allocated by:\n", s->alloc_stack, s->alloc_depth);
+    if (s->state == SLOT_FREE && s->free_depth > 0) {
+        guarded_print_stack("freed by:\n", s->free_stack, s->free_depth);
+    }
+}
+
+void guarded_fault_handler(int signo, siginfo_t* info, void* context) {
+    char* addr = info->si_addr;
+    if (addr >= guarded_pool_start && addr < guarded_pool_end) {
+        guarded_report(addr);
+    }
+
+    // Hand the fault to whoever was installed before us; returning re-faults
+    sigaction(SIGSEGV, &guarded_previous_action, NULL);
+    (void)signo;
+    (void)context;
+}
+
+
+
+// Pool
+
+// Maps `slots` pages plus guards and starts sampling one allocation in
+// `sample_rate`. A rate of 0 sets up the pool without sampling.
+int guarded_pool_init(size_t slots, uint32_t sample_rate) {
+    if (guarded_pool_start || slots == 0) {
+        return -1;
+    }
+
+    guarded_page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pool_size = (2 * slots + 1) * guarded_page_size;
+    void* pool = mmap(NULL, pool_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED) {
+        return -1;
+    }
+
+    guarded_slots = calloc(slots, sizeof(guarded_slot));
+    guarded_queue = malloc(slots * sizeof(size_t));
+    if (!guarded_slots || !guarded_queue) {
+        free(guarded_slots);
+        free(guarded_queue);
+        munmap(pool, pool_size);
+        return -1;
+    }
+
+    for (size_t i = 0; i < slots; i++) {
+        guarded_queue[i] = i;
+    }
+    guarded_queue_head = 0;
+    guarded_queue_length = slots;
+    guarded_slot_count = slots;
+    guarded_pool_start = pool;
+    guarded_pool_end = guarded_pool_start + pool_size;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = guarded_fault_handler;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &guarded_previous_action);
+
+    void* warmup[1];
+    backtrace(warmup, 1);  // Loads the unwinder now rather than inside a sample
+
+    guarded_pool_set_sample_rate(sample_rate);
+    return 0;
+}
+
+void guarded_pool_set_sample_rate(uint32_t sample_rate) {
+    guarded_sample_rate = guarded_pool_start ? sample_rate : 0;
+    guarded_rearm();
+}
+
+// Returns NULL when the allocation cannot be guarded (pool exhausted, size
+// larger than a page, or sampling off); callers fall back to the normal heap.
+void* guarded_alloc(size_t size) {
+    guarded_rearm();
+
+    if (guarded_queue_length == 0 || size + sizeof(block_meta) > guarded_page_size) {
+        return NULL;
+    }
+
+    size_t slot = guarded_queue[guarded_queue_head];
+    guarded_queue_head = (guarded_queue_head + 1) % guarded_slot_count;
+    guarded_queue_length--;
+
+    char* page = guarded_slot_page(slot);
+    if (mprotect(page, guarded_page_size, PROT_READ | PROT_WRITE) != 0) {
+        return NULL;
+    }
+
+    // Flush against the right guard to catch overflows, or the left one to
+    // catch underflows; the block_meta header always sits just before ptr.
+    char* ptr;
+    if (guarded_random() & 1) {
+        ptr = (char*)(((size_t)(page + guarded_page_size - size)) & ~(GUARDED_ALIGNMENT - 1));
+    } else {
+        ptr = page + sizeof(block_meta);
+    }
+
+    block_meta* block = (block_meta*)ptr - 1;
+    block->size = size;
+    block->free = 0;
+    block->next = NULL;
+
+    guarded_slot* s = &guarded_slots[slot];
+    s->state = SLOT_ALLOCATED;
+    s->ptr = ptr;
+    s->size = size;
+    s->alloc_depth = backtrace(s->alloc_stack, GUARDED_MAX_FRAMES);
+    s->free_depth = 0;
+    return ptr;
+}
+
+void guarded_free(void* ptr) {
+    size_t slot = ((char*)ptr - guarded_pool_start) / guarded_page_size / 2;
+    guarded_slot* s = slot < guarded_slot_count ? &guarded_slots[slot] : NULL;
+
+    if (!s || s->ptr != ptr || s->state != SLOT_ALLOCATED) {
+        fprintf(stderr, "guarded_pool: %s of %p\n", s && s->ptr == ptr ? "double free" : "invalid free", ptr);
+        if (s && s->alloc_depth > 0) {
+            guarded_print_stack("allocated by:\n", s->alloc_stack, s->alloc_depth);
+        }
+        if (s && s->free_depth > 0) {
+            guarded_print_stack("freed by:\n", s->free_stack, s->free_depth);
+        }
+        return;
+    }
+
+    s->state = SLOT_FREE;
+    s->free_depth = backtrace(s->free_stack, GUARDED_MAX_FRAMES);
+    mprotect(guarded_slot_page(slot), guarded_page_size, PROT_NONE);
+
+    guarded_queue[(guarded_queue_head + guarded_queue_length) % guarded_slot_count] = slot;
+    guarded_queue_length++;
+}
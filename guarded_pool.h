@@ -0,0 +1,33 @@
+// guarded_pool.h
+#ifndef GUARDED_POOL_H
+#define GUARDED_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sampled guard-page allocations in the style of GWP-ASan. About one in
+// `sample_rate` allocations is served from a page of its own, flanked by
+// PROT_NONE guard pages, and the page is made inaccessible when freed.
+// Overflows, underflows and use-after-free then fault immediately and are
+// reported with the allocation and free stacks.
+//
+// Every sample costs two mprotect calls and two backtrace() calls (alloc and
+// free), so the cost scales with the rate: 1/1000 or sparser costs a few
+// percent at most in the guarded phase and is the range meant to stay on in
+// production; 1/100 costs 20% or more and is for targeted debugging.
+
+extern uint32_t guarded_countdown;
+extern char* guarded_pool_start;
+extern char* guarded_pool_end;
+
+int guarded_pool_init(size_t slots, uint32_t sample_rate);
+void guarded_pool_set_sample_rate(uint32_t sample_rate);
+void* guarded_alloc(size_t size);
+void guarded_free(void* ptr);
+
+// One decrement on the allocation path; hits zero once per sample_rate calls
+#define GUARDED_SHOULD_SAMPLE() (--guarded_countdown == 0)
+
+#define GUARDED_OWNS(ptr) ((char*)(ptr) >= guarded_pool_start && (char*)(ptr) < guarded_pool_end)
+
+#endif // GUARDED_POOL_H
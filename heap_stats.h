@@ -0,0 +1,28 @@
+// heap_stats.h
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <stddef.h>
+
+#define HEAP_STATS_CLASSES 16  // Power-of-two size classes: <= 16, <= 32, ..., larger than 256 KiB
+
+// mallinfo-style snapshot of the block list shared by the fit allocators.
+// Every field is maintained incrementally, so reading it does not walk the heap.
+typedef struct heap_info {
+    size_t heap_bytes;            // Payload plus headers of every block in the list
+    size_t allocated_bytes;
+    size_t allocated_blocks;
+    size_t free_bytes;
+    size_t free_blocks;
+    size_t largest_free_block;    // Exact, or within 2x below when its size range was just split up
+    size_t peak_allocated_bytes;
+    size_t sbrk_bytes;            // Total ever obtained from sbrk
+    size_t mmap_bytes;            // Total ever mapped for huge page arenas
+    size_t allocated_by_class[HEAP_STATS_CLASSES];
+    size_t free_by_class[HEAP_STATS_CLASSES];
+} heap_info;
+
+heap_info heap_stats();
+double heap_fragmentation_index();
+
+#endif // HEAP_STATS_H
@@ -2,28 +2,30 @@
 #include <time.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
 #include "block_meta.h"
-
-
-typedef void* (*alloc_func)(size_t size);
-typedef void (*free_func)(void* ptr);
-
-typedef struct Allocator {
-    alloc_func alloc;
-    free_func free;
-    char* name;
-} Allocator;
+#include "heap_stats.h"
+#include "shm_heap.h"
+#include "guarded_pool.h"
+#include "bench.h"
 
 
 
 // C Library Malloc and Free
-// void* libc_malloc(size_t size) {
-//     return malloc(size);
-// }
+void* libc_malloc(size_t size) {
+    return malloc(size);
+}
 
-// void libc_free(void* ptr) {
-//     free(ptr);
-// }
+void libc_free(void* ptr) {
+    free(ptr);
+}
 
 
 // Allocator prototypes
@@ -35,18 +37,30 @@ void* worst_fit_alloc(size_t size);
 void worst_fit_free(void* ptr);
 void* next_fit_alloc(size_t size);
 void next_fit_free(void* ptr);
+void* adaptive_alloc(size_t size);
+void adaptive_free(void* ptr);
 size_t calculate_usable_memory();
 void reset_memory_tracking();
+void set_huge_pages(int enabled);
+size_t thp_backed_bytes();
+size_t thp_allocated_bytes();
+size_t trim_huge_pages();
 
 
 Allocator allocators[] = {
     {best_fit_alloc, best_fit_free, "Best Fit"},
     {first_fit_alloc, first_fit_free, "First Fit"},
     {worst_fit_alloc, worst_fit_free, "Worst Fit"},
-    {next_fit_alloc, next_fit_free, "Next Fit"}
-    // {libc_malloc, libc_free, "C Library"}
+    {next_fit_alloc, next_fit_free, "Next Fit"},
+    {adaptive_alloc, adaptive_free, "Adaptive"}
 };
 
+// Baseline for the multi-threaded workloads only: the other phases read
+// block_meta headers that libc allocations do not have.
+Allocator libc_allocator = {libc_malloc, libc_free, "C Library", 1};
+
+unsigned benchmark_seed = 42;
+
 
 
 
@@ -98,17 +112,22 @@ void run_latency_tests(size_t sizes[], int num_sizes, int iterations, Allocator
 // Throughput Measure
 long measure_throughput(alloc_func alloc, free_func free, size_t size, int test_duration) {
     long operations = 0;
-    time_t start_time = time(NULL);
-    time_t current_time;
+    struct timespec start, now;
+    double elapsed;
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
     do {
-        void* ptr = alloc(size);
-        free(ptr);
-        operations++;  // Increment operation count for each alloc/free pair
-        current_time = time(NULL);
-    } while (current_time - start_time < test_duration);
+        // Only read the clock every 1024 pairs so it doesn't dominate the loop
+        for (int i = 0; i < 1024; i++) {
+            void* ptr = alloc(size);
+            free(ptr);
+        }
+        operations += 1024;  // One operation per alloc/free pair
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    } while (elapsed < test_duration);
 
-    return operations / test_duration;  // Return operations per second
+    return (long)(operations / elapsed);  // Return operations per second
 }
 
 
@@ -141,7 +160,7 @@ void run_throughput_tests(size_t sizes[], int num_sizes, int test_duration, Allo
 
 // Memory Utilization Efficiency
 double simulate_allocations(Allocator allocator, size_t iterations, size_t max_size) {
-    srand((unsigned)time(NULL));
+    srand(benchmark_seed);
     void** ptrs = malloc(sizeof(void*) * iterations);
     size_t total_requested_memory = 0;
     size_t total_successful_allocated = 0; // Track successful allocations
@@ -164,8 +183,10 @@ double simulate_allocations(Allocator allocator, size_t iterations, size_t max_s
         }
     }
 
-    size_t usable_memory = calculate_usable_memory();
-    printf("usable_memory : %ld    total : %ld\n", usable_memory, total_successful_allocated);
+    heap_info info = heap_stats();
+    size_t usable_memory = info.free_bytes;
+    printf("usable_memory : %ld    total : %ld    fragmentation : %.2f\n", usable_memory, total_successful_allocated,
+           heap_fragmentation_index());
     double utilization_percentage = (double)usable_memory / total_successful_allocated * 100;
 
     // Free remaining allocations
@@ -182,7 +203,7 @@ double simulate_allocations(Allocator allocator, size_t iterations, size_t max_s
 
 // Stress Testing
 void stress_test(Allocator allocator, int operations, FILE* resultFile) {
-    srand(time(NULL));  // Seed for randomness
+    srand(benchmark_seed);  // Seed for randomness
     void** pointers = malloc(operations * sizeof(void*));
     size_t* sizes = malloc(operations * sizeof(size_t));
     int alloc_count = 0;
@@ -238,28 +259,34 @@ size_t attempt_large_allocation(Allocator alloc, size_t size) {
 // Scalability Testing
 // Function to perform allocation and deallocation
 double perform_allocations(Allocator alloc, int operations) {
-    clock_t start = clock();
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     for (int i = 0; i < operations; i++) {
         void* ptr = alloc.alloc(1024);  // Example size
         alloc.free(ptr);
     }
-    clock_t end = clock();
-    double time_spent = ((double)(end - start)) / CLOCKS_PER_SEC;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double time_spent = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     return time_spent;
 }
 
 
-// Thread function
+// Thread function: same loop, serialised by bench_alloc/bench_free when the
+// allocator is not thread-safe
 void* thread_func(void* arg) {
     Allocator* allocator = (Allocator*)arg;
-    perform_allocations(*allocator, 1000);
+    for (int i = 0; i < 1000; i++) {
+        void* ptr = bench_alloc(allocator, 1024);
+        bench_free(allocator, ptr);
+    }
     return NULL;
 }
 
-// Test multi-threaded scalability
+// Test multi-threaded scalability, in wall-clock seconds
 double test_multi_threaded(Allocator alloc, int num_threads) {
     pthread_t threads[num_threads];
-    clock_t start = clock();
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
     for (int i = 0; i < num_threads; i++) {
         pthread_create(&threads[i], NULL, thread_func, &alloc);
@@ -268,57 +295,422 @@ double test_multi_threaded(Allocator alloc, int num_threads) {
         pthread_join(threads[i], NULL);
     }
 
-    clock_t end = clock();
-    double time_spent = ((double)(end - start)) / CLOCKS_PER_SEC;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double time_spent = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     return time_spent;
 }
 
 
 
 
-int main() {
+// Huge Page Test
+// Opens a dTLB load-miss counter for this thread, or returns -1 when perf
+// events are unavailable (e.g. perf_event_paranoid or inside a container).
+int open_dtlb_miss_counter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Builds a fragmented heap of `blocks` blocks, then times best fit alloc/free
+// pairs, each of which walks the whole block list.
+void measure_huge_pages(int enabled, size_t blocks, int operations, FILE* file) {
+    set_huge_pages(enabled);
+    reset_memory_tracking();
+    srand(benchmark_seed);
+
+    void** ptrs = malloc(sizeof(void*) * blocks);
+    for (size_t i = 0; i < blocks; i++) {
+        ptrs[i] = best_fit_alloc(rand() % 4096 + 64);
+    }
+    for (size_t i = 0; i < blocks; i += 2) {
+        best_fit_free(ptrs[i]);
+        ptrs[i] = NULL;
+    }
+
+    int counter = open_dtlb_miss_counter();
+    long long dtlb_misses = -1;
+    struct timespec start, end;
+
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < operations; i++) {
+        void* ptr = best_fit_alloc(8192);  // Larger than any free block, so every search is a full walk
+        best_fit_free(ptr);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &dtlb_misses, sizeof(dtlb_misses)) != sizeof(dtlb_misses)) {
+            dtlb_misses = -1;
+        }
+        close(counter);
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(file, "%s,%zu,%.0f,%lld,%zu,%zu\n", enabled ? "THP" : "sbrk", blocks,
+            operations / seconds, dtlb_misses, thp_backed_bytes(), thp_allocated_bytes());
+
+    for (size_t i = 0; i < blocks; i++) {
+        if (ptrs[i]) {
+            best_fit_free(ptrs[i]);
+        }
+    }
+    trim_huge_pages();
+    free(ptrs);
+    set_huge_pages(0);
+}
+
+void run_huge_page_tests() {
+    FILE* file = fopen("huge_page_results.csv", "w");
+    if (!file) {
+        perror("Failed to open file");
+        return;
+    }
+
+    fprintf(file, "Mode,Blocks,Operations/s,dTLB Load Misses,THP Backed Bytes,THP Allocated Bytes\n");
+    size_t block_counts[] = {5000, 20000, 40000};
+    for (int i = 0; i < sizeof(block_counts) / sizeof(size_t); i++) {
+        measure_huge_pages(0, block_counts[i], 200, file);
+        measure_huge_pages(1, block_counts[i], 200, file);
+    }
+
+    fclose(file);
+}
+
+
+
+
+// Shared Heap Test
+// A producer process hands messages to a consumer process, either by copying
+// them through a pipe or by allocating them in a shared heap and sending only
+// the offset. The consumer maps the heap at its own address and frees each
+// message after reading it. A run whose consumer fails reports 0.
+int write_full(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int read_full(int fd, void* buf, size_t len) {
+    char* p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Reaps the consumer; 0 only if it exited cleanly
+int consumer_succeeded(pid_t pid) {
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Read one byte per cache line so both modes touch the whole message
+long consume_message(const char* message, size_t size) {
+    long sum = 0;
+    for (size_t i = 0; i < size; i += 64) {
+        sum += message[i];
+    }
+    return sum;
+}
+
+double measure_pipe_copy(size_t size, int messages) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        close(fds[1]);
+        char* message = malloc(size);
+        long sum = 0;
+        for (int i = 0; i < messages && read_full(fds[0], message, size) == 0; i++) {
+            sum += consume_message(message, size);
+        }
+        free(message);
+        _exit(sum == 0);
+    }
+
+    close(fds[0]);
+    char* message = malloc(size);
+    for (int i = 0; i < messages; i++) {
+        memset(message, i % 127 + 1, size);
+        if (write_full(fds[1], message, size) < 0) {
+            break;
+        }
+    }
+    free(message);
+    close(fds[1]);
+    if (!consumer_succeeded(pid)) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return messages / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+double measure_shared_heap(size_t size, int messages) {
+    shm_heap* heap = shm_heap_create(NULL, 64 * (size + 64) + 4096);
+    int fds[2];
+    if (!heap || pipe(fds) < 0) {
+        shm_heap_detach(heap);
+        return 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        shm_heap_detach(heap);
+        return 0;
+    }
+    if (pid == 0) {
+        close(fds[1]);
+        // Map the heap again so the consumer sees it at a different address
+        shm_heap* view = shm_heap_attach_fd(dup(shm_heap_fd(heap)));
+        size_t offset;
+        long sum = 0;
+        while (view && read_full(fds[0], &offset, sizeof(offset)) == 0 && offset != 0) {
+            char* message = shm_heap_ptr(view, offset);
+            sum += consume_message(message, size);
+            shm_heap_free(view, message);
+        }
+        _exit(sum == 0);
+    }
+
+    close(fds[0]);
+    int consumer_exited = 0;
+    for (int i = 0; i < messages && !consumer_exited; i++) {
+        char* message;
+        while (!(message = shm_heap_alloc(heap, size))) {
+            // Heap full: wait for the consumer to free something, unless it is gone
+            if (waitpid(pid, NULL, WNOHANG) == pid) {
+                consumer_exited = 1;
+                break;
+            }
+            sched_yield();
+        }
+        if (!message) {
+            break;
+        }
+        memset(message, i % 127 + 1, size);
+        size_t offset = shm_heap_offset(heap, message);
+        if (write_full(fds[1], &offset, sizeof(offset)) < 0) {
+            break;
+        }
+    }
+    size_t done = 0;
+    write_full(fds[1], &done, sizeof(done));
+    close(fds[1]);
+    int succeeded = !consumer_exited && consumer_succeeded(pid);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    shm_heap_detach(heap);
+    if (!succeeded) {
+        return 0;
+    }
+    return messages / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+void run_shared_heap_tests() {
+    FILE* file = fopen("shared_heap_results.csv", "w");
+    if (!file) {
+        perror("Failed to open file");
+        return;
+    }
+
+    // A consumer that dies must fail the write, not kill the benchmark
+    void (*previous_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+
+    fprintf(file, "Message Size,Pipe Copy Messages/s,Shared Heap Messages/s\n");
+    size_t message_sizes[] = {1024, 16384, 65536, 262144, 1048576};
+    for (int i = 0; i < sizeof(message_sizes) / sizeof(size_t); i++) {
+        int messages = (int)(((size_t)1 << 30) / message_sizes[i]);  // 1 GiB per run
+        fprintf(file, "%zu,%.0f,%.0f\n", message_sizes[i],
+                measure_pipe_copy(message_sizes[i], messages),
+                measure_shared_heap(message_sizes[i], messages));
+    }
+
+    signal(SIGPIPE, previous_sigpipe);
+    fclose(file);
+}
+
+
+
+// Guarded Pool Test
+// Random alloc/free churn over a live set of 1024 objects, with guard page
+// sampling off and at decreasing sample rates.
+uint32_t guarded_bench_rate = 0;  // Sample rate the next guarded_churn_workload runs at
+
+double guarded_churn_workload(Allocator* allocator, const bench_config* config, unsigned seed) {
+    void* live[1024] = {0};
+    long operations = bench_count(config, 200000);
+
+    guarded_pool_set_sample_rate(guarded_bench_rate);
+    double start = bench_now();
+
+    for (long i = 0; i < operations; i++) {
+        int slot = rand_r(&seed) % 1024;
+        if (live[slot]) {
+            allocator->free(live[slot]);
+            live[slot] = NULL;
+        } else {
+            live[slot] = allocator->alloc(rand_r(&seed) % 1024 + 16);
+        }
+    }
+
+    double elapsed = bench_now() - start;
+    for (int i = 0; i < 1024; i++) {
+        if (live[i]) {
+            allocator->free(live[i]);
+        }
+    }
+    guarded_pool_set_sample_rate(0);
+
+    return operations / elapsed;
+}
+
+// All rates run inside every repetition, starting from a different rate each
+// time, so heap growth or machine drift over the phase cannot land on one
+// rate. Each repetition uses the same seed for every rate, so the overhead is
+// computed per repetition against its own baseline and has its own CI.
+void run_guarded_pool_tests(Allocator allocators[], int num_allocators, const bench_config* config) {
+    FILE* file = fopen("guarded_pool_results.csv", "w");
+    if (!file) {
+        perror("Failed to open file");
+        return;
+    }
+    if (guarded_pool_init(1024, 0) != 0) {
+        fprintf(stderr, "Failed to set up the guarded pool\n");
+        fclose(file);
+        return;
+    }
+
+    bench_config single = *config;
+    single.threads = 1;  // The churn is single-threaded
 
-    // Measure Latency
+    uint32_t rates[] = {0, 10000, 1000, 100};  // 1/100 is a debugging rate, not a production one
+    int num_rates = sizeof(rates) / sizeof(uint32_t);
+    int repetitions = bench_repetitions(config);
+    static double throughput[4][BENCH_MAX_REPETITIONS];
+    static double overhead[4][BENCH_MAX_REPETITIONS];
+
+    fprintf(file, "Allocator,Sample Rate,Operations/s,CI95 Low,CI95 High,"
+                  "Overhead %%,Overhead CI95 Low,Overhead CI95 High\n");
+    for (int i = 0; i < num_allocators; i++) {
+        for (int rep = -config->warmup; rep < repetitions; rep++) {
+            unsigned seed = config->seed + config->warmup + rep;
+            for (int k = 0; k < num_rates; k++) {
+                int j = (rep + config->warmup + k) % num_rates;
+                if (config->reset && !allocators[i].thread_safe) {
+                    config->reset();
+                }
+                guarded_bench_rate = rates[j];
+                double result = guarded_churn_workload(&allocators[i], &single, seed);
+                if (rep >= 0) {
+                    throughput[j][rep] = result;
+                }
+            }
+            for (int j = 0; rep >= 0 && j < num_rates; j++) {
+                overhead[j][rep] = (throughput[0][rep] - throughput[j][rep]) / throughput[0][rep] * 100;
+            }
+        }
+
+        for (int j = 0; j < num_rates; j++) {
+            char phase[32];
+            snprintf(phase, sizeof(phase), "guarded-%u", rates[j]);
+            bench_result result = bench_summarize(throughput[j], repetitions);
+            bench_result cost = bench_summarize(overhead[j], repetitions);
+            bench_report(phase, &allocators[i], &single, repetitions, result);
+            fprintf(file, "%s,%u,%.0f,%.0f,%.0f,%.2f,%.2f,%.2f\n", allocators[i].name, rates[j],
+                    result.mean, result.ci95_low, result.ci95_high, cost.mean, cost.ci95_low, cost.ci95_high);
+        }
+    }
+
+    fclose(file);
+}
+
+
+
+// Benchmark Phases
+// Each phase can be selected on the command line; see usage() below.
+int num_allocators = sizeof(allocators) / sizeof(allocators[0]);
+
+void latency_phase(const bench_config* config) {
     size_t sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};  // Example sizes in bytes
     int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
     int iterations = 1000;  // Number of allocations/deallocations to average
-    int num_allocators = sizeof(allocators) / sizeof(allocators[0]);
 
     run_latency_tests(sizes, num_sizes, iterations, allocators, num_allocators);
-
     printf("Tests completed. Results are saved to 'latency_results.txt'.\n");
+}
 
-
-    // Measure Throughput
-    // Define sizes to test
-    // size_t sizes[] = {16, 64, 256, 1024, 4096};
-    // int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
-    // int num_allocators = sizeof(allocators) / sizeof(allocators[0]);
+void throughput_phase(const bench_config* config) {
+    size_t sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+    int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
 
     // Test duration in seconds
-    int test_duration = 10;  // Change this to increase or decrease the test duration
+    int test_duration = (int)(10 * config->scale);  // Change --scale to increase or decrease the test duration
+    if (test_duration < 1) {
+        test_duration = 1;
+    }
 
-    // Run the tests
     run_throughput_tests(sizes, num_sizes, test_duration, allocators, num_allocators);
-
     printf("Throughput tests completed. Results are saved to 'throughput_results.txt'.\n");
+}
 
-
-    // Memory Utilization Efficiency Test
-    // int num_allocators = sizeof(allocators) / sizeof(Allocator);
-    // size_t sizes[] = {1000, 2000, 5000, 10000, 20000, 50000};  // Different sizes to test
-    // int num_sizes = sizeof(sizes) / sizeof(size_t);
+void utilization_phase(const bench_config* config) {
+    size_t sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+    int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
 
     FILE* resultFile = fopen("memory_utilization_results.csv", "w");
     if (resultFile == NULL) {
         perror("Failed to open results file");
-        return 1;
+        return;
     }
     fprintf(resultFile, "Allocator,Average Utilization Percentage\n");
 
     for (int i = 0; i < num_allocators; i++) {
         double total_percentage = 0;
-        // reset_memory_tracking();
         for (int j = 0; j < num_sizes; j++) {
             double percentage = simulate_allocations(allocators[i], sizes[j], sizes[j]);
             total_percentage += percentage;
@@ -330,12 +722,14 @@ int main() {
 
     fclose(resultFile);
     printf("Tests completed. Results are saved to 'memory_utilization_results.csv'.\n");
+}
 
-    
-    // Stress Testing
-    int num_allocators = sizeof(allocators) / sizeof(Allocator);
-
+void stress_phase(const bench_config* config) {
     FILE* resultFile = fopen("stress_test_results.csv", "w");
+    if (resultFile == NULL) {
+        perror("Failed to open results file");
+        return;
+    }
     fprintf(resultFile, "Allocator,Successful Allocations\n");
 
     for (int i = 0; i < num_allocators; i++) {
@@ -345,10 +739,9 @@ int main() {
 
     fclose(resultFile);
     printf("Stress tests completed. Results are saved to 'stress_test_results.csv'.\n");
+}
 
-
-
-    // Internal Fragmentation test
+void fragmentation_phase(const bench_config* config) {
     size_t sizes[] = {16, 64, 256, 1024, 4096, 10000, 20000, 14000, 34665, 356, 500, 3359, 4543, 55683};
     size_t large_size = 100000; // For testing external fragmentation
     int num_sizes = sizeof(sizes) / sizeof(size_t);
@@ -356,12 +749,12 @@ int main() {
 
     if (file == NULL) {
         perror("Failed to open file");
-        return EXIT_FAILURE;
+        return;
     }
 
     fprintf(file, "Allocator,Total Internal Fragmentation,Success Large Allocation\n");
 
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
+    for (int i = 0; i < num_allocators; i++) {
         size_t total_internal_frag = 0;
         size_t successes = 0;
 
@@ -374,16 +767,17 @@ int main() {
     }
 
     fclose(file);
+    printf("Fragmentation tests completed. Results are saved to 'fragmentation_results.csv'.\n");
+}
 
-
-
-
-    // Scalability Test
+void scalability_phase(const bench_config* config) {
     int operations[] = {1000, 2000, 3000, 4000, 5000, 6000, 7000, 10000};
     int num_operations = sizeof(operations) / sizeof(int);
+    int thread_counts[] = {3, 5, 8, 10, 12};
+    int num_thread_counts = sizeof(thread_counts) / sizeof(int);
 
     printf("Type,Allocator,Operations,Time\n");
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
+    for (int i = 0; i < num_allocators; i++) {
         for (int j = 0; j < num_operations; j++) {
             double time = perform_allocations(allocators[i], operations[j]);
             printf("SingleThreaded,%s,%d,%f\n", allocators[i].name, operations[j], time);
@@ -391,32 +785,187 @@ int main() {
     }
 
     printf("Type,Allocator,Threads,Time\n");
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
-        double time = test_multi_threaded(allocators[i], 3);  // Testing with 5 threads
-        printf("MultiThreaded,%s,%d,%f\n", allocators[i].name, 3, time);
+    for (int j = 0; j < num_thread_counts; j++) {
+        for (int i = 0; i < num_allocators; i++) {
+            double time = test_multi_threaded(allocators[i], thread_counts[j]);
+            printf("MultiThreaded,%s,%d,%f\n", allocators[i].name, thread_counts[j], time);
+        }
+    }
+}
+
+void huge_page_phase(const bench_config* config) {
+    run_huge_page_tests();
+    printf("Huge page tests completed. Results are saved to 'huge_page_results.csv'.\n");
+}
+
+void shared_heap_phase(const bench_config* config) {
+    run_shared_heap_tests();
+    printf("Shared heap tests completed. Results are saved to 'shared_heap_results.csv'.\n");
+}
+
+void guarded_pool_phase(const bench_config* config) {
+    run_guarded_pool_tests(allocators, num_allocators, config);
+    printf("Guarded pool tests completed. Results are saved to 'guarded_pool_results.csv'.\n");
+}
+
+// Multi-threaded workloads: every allocator plus the C library as a baseline
+void run_workload(const char* phase, bench_workload workload, const bench_config* config) {
+    for (int i = 0; i < num_allocators; i++) {
+        fprintf(stderr, "Running %s for %s...\n", phase, allocators[i].name);
+        bench_run(phase, &allocators[i], workload, config);
     }
+    fprintf(stderr, "Running %s for %s...\n", phase, libc_allocator.name);
+    bench_run(phase, &libc_allocator, workload, config);
+}
 
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
-        double time = test_multi_threaded(allocators[i], 5);  // Testing with 5 threads
-        printf("MultiThreaded,%s,%d,%f\n", allocators[i].name, 5, time);
+void larson_phase(const bench_config* config) {
+    run_workload("larson", larson_workload, config);
+}
+
+void threadtest_phase(const bench_config* config) {
+    run_workload("threadtest", threadtest_workload, config);
+}
+
+void xmalloc_phase(const bench_config* config) {
+    run_workload("xmalloc", xmalloc_workload, config);
+}
+
+void churn_phase(const bench_config* config) {
+    run_workload("churn", churn_workload, config);
+}
+
+
+typedef struct Phase {
+    char* name;
+    void (*run)(const bench_config* config);
+    char* description;
+} Phase;
+
+Phase phases[] = {
+    {"latency", latency_phase, "average alloc latency per size -> latency_results.txt"},
+    {"throughput", throughput_phase, "alloc/free pairs per second per size -> throughput_results.txt"},
+    {"utilization", utilization_phase, "free memory after random frees -> memory_utilization_results.csv"},
+    {"stress", stress_phase, "100,000 mixed operations -> stress_test_results.csv"},
+    {"fragmentation", fragmentation_phase, "internal and external fragmentation -> fragmentation_results.csv"},
+    {"scalability", scalability_phase, "single and multi-threaded wall time -> stdout"},
+    {"hugepages", huge_page_phase, "sbrk vs THP arenas -> huge_page_results.csv"},
+    {"shared", shared_heap_phase, "pipe copy vs shared heap -> shared_heap_results.csv"},
+    {"guarded", guarded_pool_phase, "guard page sampling overhead -> guarded_pool_results.csv and driver output"},
+    {"larson", larson_phase, "Larson server simulation -> driver output"},
+    {"threadtest", threadtest_phase, "per-thread batch alloc/free -> driver output"},
+    {"xmalloc", xmalloc_phase, "producer/consumer cross-thread free -> driver output"},
+    {"churn", churn_phase, "mixed-size random churn -> driver output"}
+};
+int num_phases = sizeof(phases) / sizeof(phases[0]);
+
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --phases LIST    comma-separated phases to run (default: all)\n"
+            "  --seed N         seed for every randomised workload (default: 42)\n"
+            "  --warmup N       untimed runs before measuring (default: 1)\n"
+            "  --reps N         measured repetitions (default: 5)\n"
+            "  --threads N      threads for the multi-threaded workloads (default: 4)\n"
+            "  --scale X        multiply operation counts and durations (default: 1.0)\n"
+            "  --format FORMAT  csv or json (default: csv)\n"
+            "  --output FILE    driver results file (default: bench_results.csv/.json, '-' for stdout)\n"
+            "  --list           list the phases and exit\n"
+            "\n"
+            "Phases marked 'driver output' report mean operations/s with a 95%% confidence\n"
+            "interval over the repetitions; the others write their own result files.\n",
+            program);
+}
+
+int phase_selected(const char* list, const char* name) {
+    size_t len = strlen(name);
+    for (const char* p = list; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL) {
+        if (strncmp(p, name, len) == 0 && (p[len] == ',' || p[len] == '\0')) {
+            return 1;
+        }
     }
+    return 0;
+}
 
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
-        double time = test_multi_threaded(allocators[i], 8);  // Testing with 5 threads
-        printf("MultiThreaded,%s,%d,%f\n", allocators[i].name, 8, time);
+int main(int argc, char* argv[]) {
+    bench_config config = {42, 1, 5, 4, 1.0, BENCH_CSV, NULL, reset_memory_tracking};
+    const char* phase_list = "all";
+    const char* output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--list") == 0) {
+            for (int j = 0; j < num_phases; j++) {
+                printf("%-14s %s\n", phases[j].name, phases[j].description);
+            }
+            return 0;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (!value) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else if (strcmp(arg, "--phases") == 0) {
+            phase_list = value;
+        } else if (strcmp(arg, "--seed") == 0) {
+            config.seed = (unsigned)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            config.warmup = atoi(value);
+        } else if (strcmp(arg, "--reps") == 0) {
+            config.repetitions = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            config.threads = atoi(value) > 0 ? atoi(value) : 1;
+        } else if (strcmp(arg, "--scale") == 0) {
+            config.scale = atof(value);
+        } else if (strcmp(arg, "--format") == 0) {
+            config.format = strcmp(value, "json") == 0 ? BENCH_JSON : BENCH_CSV;
+        } else if (strcmp(arg, "--output") == 0) {
+            output = value;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;  // Consumed the value
     }
 
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
-        double time = test_multi_threaded(allocators[i], 10);  // Testing with 5 threads
-        printf("MultiThreaded,%s,%d,%f\n", allocators[i].name, 10, time);
+    int run_all = strcmp(phase_list, "all") == 0;
+    for (const char* p = phase_list; !run_all && p && *p; ) {
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        int known = 0;
+        for (int j = 0; j < num_phases; j++) {
+            known |= strlen(phases[j].name) == len && strncmp(phases[j].name, p, len) == 0;
+        }
+        if (!known) {
+            fprintf(stderr, "Unknown phase '%.*s' (see --list)\n", (int)len, p);
+            return EXIT_FAILURE;
+        }
+        p = end ? end + 1 : NULL;
     }
 
-    for (int i = 0; i < sizeof(allocators) / sizeof(Allocator); i++) {
-        double time = test_multi_threaded(allocators[i], 12);  // Testing with 5 threads
-        printf("MultiThreaded,%s,%d,%f\n", allocators[i].name, 12, time);
+    if (!output) {
+        output = config.format == BENCH_JSON ? "bench_results.json" : "bench_results.csv";
     }
+    config.out = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+    if (!config.out) {
+        perror("Failed to open output file");
+        return EXIT_FAILURE;
+    }
+    benchmark_seed = config.seed;
 
+    bench_begin(&config);
+    for (int i = 0; i < num_phases; i++) {
+        if (run_all || phase_selected(phase_list, phases[i].name)) {
+            phases[i].run(&config);
+        }
+    }
+    bench_end(&config);
 
+    if (config.out != stdout) {
+        fclose(config.out);
+        printf("Driver results are saved to '%s'.\n", output);
+    }
     return 0;
 }
-
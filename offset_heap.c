@@ -0,0 +1,105 @@
+#include "block_meta.h"
+#include "offset_heap.h"
+
+
+offset_block_meta* offset_heap_block(char* base, size_t offset) {
+    return offset ? (offset_block_meta*)(base + offset) : NULL;
+}
+
+// Without a hook the steps still have to land in program order: a process
+// that dies holding shm_heap's lock must leave a well-formed list, and the
+// compiler is otherwise free to reorder plain stores. The CPU drains the
+// stores a dead process already executed, so a compiler barrier is enough.
+void offset_heap_persist(offset_heap_persist_fn persist, void* context, const void* addr, size_t len) {
+    if (persist) {
+        persist(context, addr, len);
+    } else {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+
+
+// Allocation
+// Every step below is a single store that is persisted before the next one,
+// so an interrupted update can leak a block but never hand the same bytes out
+// twice, and the list stays well formed for the next caller.
+
+void* offset_heap_alloc(char* base, offset_heap_state* state, size_t size,
+                        offset_heap_persist_fn persist, void* context) {
+    if (size <= 0 || size > state->capacity) {
+        return NULL;  // Also keeps the round-up and header below from overflowing
+    }
+    size = round_up(size, sizeof(void*));
+
+    size_t* link = &state->free_head;
+    offset_block_meta* block = offset_heap_block(base, *link);
+    while (block && block->size < size) {
+        link = &block->next;
+        block = offset_heap_block(base, *link);
+    }
+
+    if (block) {
+        size_t replacement = block->next;
+
+        if (block->size > size + sizeof(offset_block_meta) + sizeof(void*)) {
+            // 1. Write the remainder header while it is still unreachable
+            size_t remainder_offset = *link + sizeof(offset_block_meta) + size;
+            offset_block_meta* remainder = offset_heap_block(base, remainder_offset);
+            remainder->size = block->size - size - sizeof(offset_block_meta);
+            remainder->free = 1;
+            remainder->next = block->next;
+            offset_heap_persist(persist, context, remainder, sizeof(offset_block_meta));
+
+            // 2. Shrink the block; an interruption here only leaks the remainder
+            block->size = size;
+            offset_heap_persist(persist, context, &block->size, sizeof(block->size));
+            replacement = remainder_offset;
+        }
+
+        // 3. Unlink the block (and link the remainder) with one store
+        *link = replacement;
+        offset_heap_persist(persist, context, link, sizeof(*link));
+
+        block->free = 0;
+        offset_heap_persist(persist, context, &block->free, sizeof(block->free));
+        return (block + 1);
+    }
+
+    size_t total_size = size + sizeof(offset_block_meta);
+    if (state->capacity - state->top < total_size) {
+        return NULL;  // The mapping is full
+    }
+
+    // Write the header first, then publish it by moving top
+    block = offset_heap_block(base, state->top);
+    block->size = size;
+    block->free = 0;
+    block->next = 0;
+    offset_heap_persist(persist, context, block, sizeof(offset_block_meta));
+
+    state->top += total_size;
+    offset_heap_persist(persist, context, &state->top, sizeof(state->top));
+    return (block + 1);
+}
+
+void offset_heap_free(char* base, offset_heap_state* state, void* ptr,
+                      offset_heap_persist_fn persist, void* context) {
+    if (!ptr) {
+        return;
+    }
+
+    offset_block_meta* block_ptr = (offset_block_meta*)ptr - 1;
+    if (block_ptr->free) {
+        return;  // Double free
+    }
+
+    block_ptr->next = state->free_head;
+    block_ptr->free = 1;
+    offset_heap_persist(persist, context, block_ptr, sizeof(offset_block_meta));
+
+    state->free_head = (size_t)((char*)block_ptr - base);
+    offset_heap_persist(persist, context, &state->free_head, sizeof(state->free_head));
+
+    // Optional: Coalesce free blocks here
+}
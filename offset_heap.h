@@ -0,0 +1,28 @@
+// offset_heap.h
+#ifndef OFFSET_HEAP_H
+#define OFFSET_HEAP_H
+
+#include <stddef.h>
+#include "block_meta.h"
+
+// First fit over an explicit free list of offset_block_meta, shared by the
+// heaps that live in a relocatable mapping (pheap, shm_heap). Each of them
+// embeds offset_heap_state in its header and does its own locking.
+
+typedef struct offset_heap_state {
+    size_t capacity;    // Size of the mapping in bytes
+    size_t top;         // First byte never handed out
+    size_t free_head;   // First block on the free list
+} offset_heap_state;
+
+// Called after every metadata store, in program order, so a heap can make
+// each one durable before the next is written. Pass NULL when not needed.
+typedef void (*offset_heap_persist_fn)(void* context, const void* addr, size_t len);
+
+offset_block_meta* offset_heap_block(char* base, size_t offset);
+void* offset_heap_alloc(char* base, offset_heap_state* state, size_t size,
+                        offset_heap_persist_fn persist, void* context);
+void offset_heap_free(char* base, offset_heap_state* state, void* ptr,
+                      offset_heap_persist_fn persist, void* context);
+
+#endif // OFFSET_HEAP_H
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "block_meta.h"
+#include "offset_heap.h"
+#include "pheap.h"
+
+
+#define PHEAP_MAGIC 0x5048454150000001ULL  // "PHEAP" + layout version
+#define PHEAP_MIN_CAPACITY 4096
+
+// Lives at offset 0 of the file. Every link is an offset from this header.
+typedef struct pheap_header {
+    uint64_t magic;
+    offset_heap_state state;  // Capacity, top and free list; capacity is the file size
+    size_t root;        // Offset of the root object, 0 if unset
+    uintptr_t base;     // Address the file was last mapped at (informational)
+    int clean;          // Cleared while open without PHEAP_DURABLE
+} pheap_header;
+
+struct pheap {
+    char* base;
+    size_t size;
+    int fd;
+    int flags;
+};
+
+
+pheap_header* pheap_hdr(pheap* heap) {
+    return (pheap_header*)heap->base;
+}
+
+// In durable mode, flush [addr, addr + len) before any later store can land.
+// This is what orders the metadata updates; it is also the offset_heap hook.
+// Otherwise the steps still reach the page cache in program order, which is
+// what lets PHEAP_RECOVER reopen a heap after a process crash.
+void pheap_persist(void* context, const void* addr, size_t len) {
+    pheap* heap = context;
+    if (!(heap->flags & PHEAP_DURABLE)) {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        return;
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    msync((void*)start, end - start, MS_SYNC);
+}
+
+
+
+// Open / Close
+
+void* pheap_map(int fd, size_t size, void* base) {
+    if (!base) {
+        void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return addr == MAP_FAILED ? NULL : addr;
+    }
+
+#ifdef MAP_FIXED_NOREPLACE
+    void* addr = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+#else
+    void* addr = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#endif
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    if (addr != base) {  // Kernel ignored the hint, don't clobber whatever is there
+        munmap(addr, size);
+        errno = EEXIST;
+        return NULL;
+    }
+    return addr;
+}
+
+// Rebuilds the free list of a heap that was not closed cleanly from the
+// blocks' own flags. Fails if the block chain from the header to top is not
+// consistent. Every free-list step is a single ordered store, so after a
+// process crash this also picks up a block a half-finished alloc had split off.
+int pheap_recover(pheap* heap) {
+    pheap_header* header = pheap_hdr(heap);
+    size_t first = round_up(sizeof(pheap_header), sizeof(void*));
+    size_t top = header->state.top;
+    if (top < first || top > header->state.capacity
+        || (header->root && (header->root < first + sizeof(offset_block_meta) || header->root >= top))) {
+        return 0;
+    }
+
+    offset_block_meta* block;
+    for (size_t offset = first; offset < top; offset += sizeof(offset_block_meta) + block->size) {
+        block = offset_heap_block(heap->base, offset);
+        if (top - offset < sizeof(offset_block_meta) || block->size % sizeof(void*)
+            || block->size > top - offset - sizeof(offset_block_meta)) {
+            return 0;
+        }
+    }
+
+    size_t* link = &header->state.free_head;
+    for (size_t offset = first; offset < top; offset += sizeof(offset_block_meta) + block->size) {
+        block = offset_heap_block(heap->base, offset);
+        if (block->free) {
+            *link = offset;
+            link = &block->next;
+        }
+    }
+    *link = 0;
+
+    header->clean = 1;
+    msync(heap->base, heap->size, MS_SYNC);
+    return 1;
+}
+
+// Opens `path`, creating a heap of `capacity` bytes if the file is empty.
+// An existing heap is restored as-is: no block or free list is walked.
+// Pass `base` to require a fixed mapping address, or NULL to relocate freely.
+pheap* pheap_open(const char* path, size_t capacity, void* base, int flags) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    int fresh = st.st_size == 0;
+    size_t size = fresh ? round_up(capacity, PHEAP_MIN_CAPACITY) : (size_t)st.st_size;
+    if (!fresh && size < sizeof(pheap_header)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (fresh && ftruncate(fd, size) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* addr = pheap_map(fd, size, base);
+    if (!addr) {
+        close(fd);
+        return NULL;
+    }
+
+    pheap* heap = malloc(sizeof(pheap));
+    if (!heap) {
+        munmap(addr, size);
+        close(fd);
+        return NULL;
+    }
+    heap->base = addr;
+    heap->size = size;
+    heap->fd = fd;
+    heap->flags = flags;
+
+    pheap_header* header = pheap_hdr(heap);
+    if (fresh) {
+        header->state.capacity = size;
+        header->state.top = round_up(sizeof(pheap_header), sizeof(void*));
+        header->state.free_head = 0;
+        header->root = 0;
+        header->clean = 1;
+        pheap_persist(heap, header, sizeof(pheap_header));
+        header->magic = PHEAP_MAGIC;  // Published last: a torn create is detected
+        pheap_persist(heap, header, sizeof(pheap_header));
+    } else if (header->magic != PHEAP_MAGIC || header->state.capacity != size
+               || (!header->clean && !((flags & PHEAP_RECOVER) && pheap_recover(heap)))) {
+        // Wrong format, or a non-durable session crashed and was not recovered
+        munmap(addr, size);
+        close(fd);
+        free(heap);
+        errno = EIO;
+        return NULL;
+    }
+
+    header->base = (uintptr_t)addr;
+    if (!(flags & PHEAP_DURABLE)) {
+        header->clean = 0;
+    }
+    pheap_persist(heap, header, sizeof(pheap_header));
+    return heap;
+}
+
+int pheap_sync(pheap* heap) {
+    return msync(heap->base, heap->size, MS_SYNC);
+}
+
+int pheap_close(pheap* heap) {
+    if (!heap) {
+        return 0;
+    }
+
+    pheap_hdr(heap)->clean = 1;
+    int result = pheap_sync(heap);
+    munmap(heap->base, heap->size);
+    close(heap->fd);
+    free(heap);
+    return result;
+}
+
+
+
+// Offsets
+
+size_t pheap_offset(pheap* heap, const void* ptr) {
+    return ptr ? (size_t)((const char*)ptr - heap->base) : 0;
+}
+
+void* pheap_ptr(pheap* heap, size_t offset) {
+    return offset ? heap->base + offset : NULL;
+}
+
+void pheap_set_root(pheap* heap, void* ptr) {
+    pheap_header* header = pheap_hdr(heap);
+    header->root = pheap_offset(heap, ptr);
+    pheap_persist(heap, &header->root, sizeof(header->root));
+}
+
+void* pheap_get_root(pheap* heap) {
+    return pheap_ptr(heap, pheap_hdr(heap)->root);
+}
+
+
+
+// Allocation
+// First fit over the offset free list, with pheap_persist as the ordering hook.
+
+void* pheap_alloc(pheap* heap, size_t size) {
+    return offset_heap_alloc(heap->base, &pheap_hdr(heap)->state, size, pheap_persist, heap);
+}
+
+void pheap_free(pheap* heap, void* ptr) {
+    offset_heap_free(heap->base, &pheap_hdr(heap)->state, ptr, pheap_persist, heap);
+}
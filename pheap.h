@@ -0,0 +1,35 @@
+// pheap.h
+#ifndef PHEAP_H
+#define PHEAP_H
+
+#include <stddef.h>
+
+// Persistent heap backed by a MAP_SHARED file mapping. Block headers and the
+// free list are stored as offsets, so the file can be mapped at any address
+// and is usable again as soon as pheap_open returns.
+
+#define PHEAP_DURABLE 0x1  // msync every metadata update in crash-safe order
+
+// Without PHEAP_DURABLE a heap that was not closed with pheap_close fails to
+// open with EIO. PHEAP_RECOVER opens it anyway after checking the block chain
+// and rebuilding the free list. That is sound after a process crash, whose
+// stores all reached the page cache in order, but not after an OS crash or
+// power loss, where the kernel may have written pages back in any order.
+#define PHEAP_RECOVER 0x2
+
+typedef struct pheap pheap;
+
+pheap* pheap_open(const char* path, size_t capacity, void* base, int flags);
+int pheap_close(pheap* heap);
+int pheap_sync(pheap* heap);
+
+void* pheap_alloc(pheap* heap, size_t size);
+void pheap_free(pheap* heap, void* ptr);
+
+void pheap_set_root(pheap* heap, void* ptr);
+void* pheap_get_root(pheap* heap);
+
+size_t pheap_offset(pheap* heap, const void* ptr);
+void* pheap_ptr(pheap* heap, size_t offset);
+
+#endif // PHEAP_H
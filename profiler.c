@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <pthread.h>
+#include <execinfo.h>
+#include "profiler.h"
+
+
+#define PROFILER_MAX_FRAMES 32
+#define PROFILER_STACK_BUCKETS 4096
+#define PROFILER_OBJECT_BUCKETS 65536
+
+// One entry per distinct call stack
+typedef struct profile_stack {
+    uint64_t hash;
+    int depth;
+    void* frames[PROFILER_MAX_FRAMES];
+    size_t live_count;
+    size_t live_bytes;
+    size_t total_count;
+    size_t total_bytes;
+    struct profile_stack* next;
+} profile_stack;
+
+// One entry per sampled allocation that has not been freed yet
+typedef struct profile_object {
+    void* ptr;
+    size_t size;
+    profile_stack* stack;
+    struct profile_object* next;
+} profile_object;
+
+int64_t profiler_bytes_until_sample = INT64_MAX;
+size_t profiler_live_samples = 0;
+
+int profiler_running = 0;
+size_t profiler_interval = 0;
+uint64_t profiler_rng = 0x9e3779b97f4a7c15ULL;
+pthread_mutex_t profiler_lock = PTHREAD_MUTEX_INITIALIZER;
+
+profile_stack* profile_stacks[PROFILER_STACK_BUCKETS];
+profile_object* profile_objects[PROFILER_OBJECT_BUCKETS];
+
+volatile sig_atomic_t profiler_dump_requested = 0;
+const char* profiler_signal_path = NULL;
+int profiler_signal_format = PROFILER_FORMAT_PPROF;
+
+
+// Bytes to the next sample, drawn from an exponential distribution so every
+// byte allocated is equally likely to trigger a sample.
+int64_t profiler_next_interval() {
+    profiler_rng ^= profiler_rng << 13;
+    profiler_rng ^= profiler_rng >> 7;
+    profiler_rng ^= profiler_rng << 17;
+    double u = ((profiler_rng >> 11) + 1.0) / 9007199254740993.0;  // (0, 1]
+    return (int64_t)(-log(u) * profiler_interval) + 1;
+}
+
+uint64_t profiler_hash_frames(void** frames, int depth) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; i < depth; i++) {
+        hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+size_t profiler_object_bucket(void* ptr) {
+    return ((uintptr_t)ptr >> 4) * 11400714819323198485ULL >> (64 - 16);
+}
+
+profile_stack* profiler_find_stack(void** frames, int depth) {
+    uint64_t hash = profiler_hash_frames(frames, depth);
+    profile_stack** bucket = &profile_stacks[hash % PROFILER_STACK_BUCKETS];
+
+    for (profile_stack* stack = *bucket; stack; stack = stack->next) {
+        if (stack->hash == hash && stack->depth == depth
+            && memcmp(stack->frames, frames, depth * sizeof(void*)) == 0) {
+            return stack;
+        }
+    }
+
+    profile_stack* stack = calloc(1, sizeof(profile_stack));
+    if (!stack) {
+        return NULL;
+    }
+    stack->hash = hash;
+    stack->depth = depth;
+    memcpy(stack->frames, frames, depth * sizeof(void*));
+    stack->next = *bucket;
+    *bucket = stack;
+    return stack;
+}
+
+
+
+// Control
+
+void profiler_start(size_t sample_interval) {
+    void* warmup[1];
+    backtrace(warmup, 1);  // Loads the unwinder now rather than inside a sample
+
+    pthread_mutex_lock(&profiler_lock);
+    profiler_interval = sample_interval ? sample_interval : 1;
+    profiler_running = 1;
+    profiler_bytes_until_sample = profiler_next_interval();
+    pthread_mutex_unlock(&profiler_lock);
+}
+
+// Stops sampling. Objects already sampled are still tracked until freed.
+void profiler_stop() {
+    pthread_mutex_lock(&profiler_lock);
+    profiler_running = 0;
+    profiler_bytes_until_sample = INT64_MAX;
+    pthread_mutex_unlock(&profiler_lock);
+}
+
+
+
+// Sampling
+
+void profiler_record_alloc(void* ptr, size_t size) {
+    pthread_mutex_lock(&profiler_lock);
+
+    if (profiler_dump_requested) {
+        profiler_dump_requested = 0;
+        pthread_mutex_unlock(&profiler_lock);
+        profiler_dump(profiler_signal_path, profiler_signal_format);
+        pthread_mutex_lock(&profiler_lock);
+    }
+
+    if (profiler_bytes_until_sample >= 0) {
+        pthread_mutex_unlock(&profiler_lock);
+        return;  // Only the dump was due, not a sample
+    }
+
+    if (!profiler_running) {
+        profiler_bytes_until_sample = INT64_MAX;
+        pthread_mutex_unlock(&profiler_lock);
+        return;
+    }
+    profiler_bytes_until_sample = profiler_next_interval();
+
+    void* frames[PROFILER_MAX_FRAMES + 1];
+    int depth = backtrace(frames, PROFILER_MAX_FRAMES + 1) - 1;  // Drop this function
+    if (depth < 0) {
+        depth = 0;
+    }
+    profile_stack* stack = profiler_find_stack(frames + 1, depth);
+    profile_object* object = malloc(sizeof(profile_object));
+    if (!stack || !object || !ptr) {
+        free(object);
+        pthread_mutex_unlock(&profiler_lock);
+        return;
+    }
+
+    stack->live_count++;
+    stack->live_bytes += size;
+    stack->total_count++;
+    stack->total_bytes += size;
+
+    size_t bucket = profiler_object_bucket(ptr);
+    object->ptr = ptr;
+    object->size = size;
+    object->stack = stack;
+    object->next = profile_objects[bucket];
+    profile_objects[bucket] = object;
+    profiler_live_samples++;
+
+    pthread_mutex_unlock(&profiler_lock);
+}
+
+void profiler_record_free(void* ptr) {
+    pthread_mutex_lock(&profiler_lock);
+
+    profile_object** link = &profile_objects[profiler_object_bucket(ptr)];
+    while (*link && (*link)->ptr != ptr) {
+        link = &(*link)->next;
+    }
+
+    profile_object* object = *link;
+    if (object) {
+        *link = object->next;
+        object->stack->live_count--;
+        object->stack->live_bytes -= object->size;
+        profiler_live_samples--;
+        free(object);
+    }
+
+    pthread_mutex_unlock(&profiler_lock);
+}
+
+
+
+// Output
+
+// Legacy gperftools heap profile, readable with `pprof <binary> <file>`.
+// Counts are raw samples; the heap_v2 header tells pprof how to scale them.
+void profiler_write_pprof(FILE* file) {
+    size_t live_count = 0, live_bytes = 0, total_count = 0, total_bytes = 0;
+    for (int i = 0; i < PROFILER_STACK_BUCKETS; i++) {
+        for (profile_stack* stack = profile_stacks[i]; stack; stack = stack->next) {
+            live_count += stack->live_count;
+            live_bytes += stack->live_bytes;
+            total_count += stack->total_count;
+            total_bytes += stack->total_bytes;
+        }
+    }
+
+    fprintf(file, "heap profile: %zu: %zu [ %zu: %zu] @ heap_v2/%zu\n",
+            live_count, live_bytes, total_count, total_bytes, profiler_interval);
+    for (int i = 0; i < PROFILER_STACK_BUCKETS; i++) {
+        for (profile_stack* stack = profile_stacks[i]; stack; stack = stack->next) {
+            fprintf(file, "%zu: %zu [%zu: %zu] @", stack->live_count, stack->live_bytes,
+                    stack->total_count, stack->total_bytes);
+            for (int f = 0; f < stack->depth; f++) {
+                fprintf(file, " %p", stack->frames[f]);
+            }
+            fprintf(file, "\n");
+        }
+    }
+
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char line[512];
+        while (fgets(line, sizeof(line), maps)) {
+            fputs(line, file);
+        }
+        fclose(maps);
+    }
+}
+
+void profiler_write_text(FILE* file) {
+    fprintf(file, "Sampling interval: %zu bytes\n", profiler_interval);
+    for (int i = 0; i < PROFILER_STACK_BUCKETS; i++) {
+        for (profile_stack* stack = profile_stacks[i]; stack; stack = stack->next) {
+            fprintf(file, "\nlive: %zu objects, %zu bytes   cumulative: %zu objects, %zu bytes\n",
+                    stack->live_count, stack->live_bytes, stack->total_count, stack->total_bytes);
+            char** symbols = backtrace_symbols(stack->frames, stack->depth);
+            for (int f = 0; f < stack->depth; f++) {
+                fprintf(file, "    %s\n", symbols ? symbols[f] : "?");
+            }
+            free(symbols);
+        }
+    }
+}
+
+int profiler_dump(const char* path, int format) {
+    FILE* file = path ? fopen(path, "w") : stderr;
+    if (!file) {
+        perror("Failed to open profile");
+        return -1;
+    }
+
+    pthread_mutex_lock(&profiler_lock);
+    if (format == PROFILER_FORMAT_TEXT) {
+        profiler_write_text(file);
+    } else {
+        profiler_write_pprof(file);
+    }
+    pthread_mutex_unlock(&profiler_lock);
+
+    if (file != stderr) {
+        fclose(file);
+    }
+    return 0;
+}
+
+// Writing a profile is not async-signal-safe, so the handler only sets the
+// flag PROFILE_ALLOC tests; the next allocation's slow path does the dump.
+void profiler_signal_handler(int signo) {
+    (void)signo;
+    profiler_dump_requested = 1;
+}
+
+int profiler_dump_on_signal(int signo, const char* path, int format) {
+    profiler_signal_path = path;
+    profiler_signal_format = format;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = profiler_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(signo, &action, NULL);
+}
@@ -0,0 +1,44 @@
+// profiler.h
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+
+// Sampling heap profiler. On average one allocation every `sample_interval`
+// bytes has its call stack recorded and is tracked until it is freed.
+// Profiles are written in the legacy pprof heap format or as plain text.
+
+#define PROFILER_FORMAT_PPROF 0
+#define PROFILER_FORMAT_TEXT 1
+
+extern int64_t profiler_bytes_until_sample;  // INT64_MAX while stopped
+extern size_t profiler_live_samples;
+extern volatile sig_atomic_t profiler_dump_requested;  // Set by the dump signal handler
+
+void profiler_start(size_t sample_interval);
+void profiler_stop();
+void profiler_record_alloc(void* ptr, size_t size);
+void profiler_record_free(void* ptr);
+int profiler_dump(const char* path, int format);
+int profiler_dump_on_signal(int signo, const char* path, int format);
+
+// The whole cost on the allocation path while the profiler is stopped. The
+// signal handler only sets its own flag: storing into the counter could be
+// lost to this non-atomic read-modify-write.
+#define PROFILE_ALLOC(ptr, size) \
+    do { \
+        if ((profiler_bytes_until_sample -= (int64_t)(size)) < 0 || profiler_dump_requested) { \
+            profiler_record_alloc((ptr), (size)); \
+        } \
+    } while (0)
+
+#define PROFILE_FREE(ptr) \
+    do { \
+        if (profiler_live_samples) { \
+            profiler_record_free(ptr); \
+        } \
+    } while (0)
+
+#endif // PROFILER_H
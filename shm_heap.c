@@ -0,0 +1,208 @@
+#define _GNU_SOURCE  // For memfd_create
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "block_meta.h"
+#include "offset_heap.h"
+#include "shm_heap.h"
+
+
+#define SHM_HEAP_MAGIC 0x53484d4845415001ULL  // "SHMHEAP" + layout version
+
+// Lives at offset 0 of the shared object. Every link is an offset from here.
+typedef struct shm_heap_header {
+    uint64_t magic;
+    offset_heap_state state;  // Capacity, top and free list; capacity is the object size
+    pthread_mutex_t lock;   // PTHREAD_PROCESS_SHARED | PTHREAD_MUTEX_ROBUST
+} shm_heap_header;
+
+struct shm_heap {
+    char* base;  // Where this process mapped the object
+    size_t size;
+    int fd;
+};
+
+
+shm_heap_header* shm_heap_hdr(shm_heap* heap) {
+    return (shm_heap_header*)heap->base;
+}
+
+// offset_heap publishes every update with a single store to a link, so when
+// a process dies holding the lock the list is still well formed and the next
+// owner only has to mark the mutex consistent.
+void shm_heap_lock(shm_heap* heap) {
+    if (pthread_mutex_lock(&shm_heap_hdr(heap)->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&shm_heap_hdr(heap)->lock);
+    }
+}
+
+void shm_heap_unlock(shm_heap* heap) {
+    pthread_mutex_unlock(&shm_heap_hdr(heap)->lock);
+}
+
+
+
+// Create / Attach
+
+shm_heap* shm_heap_map(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(shm_heap_header)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    shm_heap* heap = malloc(sizeof(shm_heap));
+    if (!heap) {
+        munmap(addr, st.st_size);
+        return NULL;
+    }
+    heap->base = addr;
+    heap->size = st.st_size;
+    heap->fd = fd;
+    return heap;
+}
+
+// Undo a half-finished create so a retry with the same name does not hit
+// EEXIST on an object nobody will ever initialise.
+void shm_heap_abandon(const char* name, int fd) {
+    int saved = errno;
+    close(fd);
+    if (name) {
+        shm_unlink(name);
+    }
+    errno = saved;
+}
+
+// Creates a heap of `capacity` bytes. With a name it is a POSIX shared memory
+// object other processes can shm_heap_attach to; with NULL it is an anonymous
+// memfd that children inherit or that can be passed over a unix socket.
+shm_heap* shm_heap_create(const char* name, size_t capacity) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = round_up(capacity, page);
+    int fd = name ? shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600) : memfd_create("shm_heap", 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, size) < 0) {
+        shm_heap_abandon(name, fd);
+        return NULL;
+    }
+
+    shm_heap* heap = shm_heap_map(fd);
+    if (!heap) {
+        shm_heap_abandon(name, fd);
+        return NULL;
+    }
+
+    shm_heap_header* header = shm_heap_hdr(heap);
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    header->state.capacity = size;
+    header->state.top = round_up(sizeof(shm_heap_header), sizeof(void*));
+    header->state.free_head = 0;
+    __atomic_store_n(&header->magic, SHM_HEAP_MAGIC, __ATOMIC_RELEASE);  // Ready for attachers
+    return heap;
+}
+
+shm_heap* shm_heap_attach_fd(int fd) {
+    shm_heap* heap = shm_heap_map(fd);
+    if (!heap) {
+        return NULL;
+    }
+    if (__atomic_load_n(&shm_heap_hdr(heap)->magic, __ATOMIC_ACQUIRE) != SHM_HEAP_MAGIC
+        || shm_heap_hdr(heap)->state.capacity != heap->size) {
+        munmap(heap->base, heap->size);
+        free(heap);
+        errno = EINVAL;
+        return NULL;
+    }
+    return heap;
+}
+
+shm_heap* shm_heap_attach(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    shm_heap* heap = shm_heap_attach_fd(fd);
+    if (!heap) {
+        close(fd);
+    }
+    return heap;
+}
+
+void shm_heap_detach(shm_heap* heap) {
+    if (!heap) {
+        return;
+    }
+
+    munmap(heap->base, heap->size);
+    close(heap->fd);
+    free(heap);
+}
+
+int shm_heap_unlink(const char* name) {
+    return shm_unlink(name);
+}
+
+int shm_heap_fd(shm_heap* heap) {
+    return heap->fd;
+}
+
+
+
+// Offsets
+// Pointers are only meaningful in the process that produced them; exchange
+// offsets between processes and convert back with shm_heap_ptr.
+
+size_t shm_heap_offset(shm_heap* heap, const void* ptr) {
+    return ptr ? (size_t)((const char*)ptr - heap->base) : 0;
+}
+
+void* shm_heap_ptr(shm_heap* heap, size_t offset) {
+    return offset ? heap->base + offset : NULL;
+}
+
+
+
+// Allocation
+// First fit over the offset free list, under the shared lock.
+
+void* shm_heap_alloc(shm_heap* heap, size_t size) {
+    shm_heap_lock(heap);
+    void* ptr = offset_heap_alloc(heap->base, &shm_heap_hdr(heap)->state, size, NULL, NULL);
+    shm_heap_unlock(heap);
+    return ptr;
+}
+
+// `ptr` may come from any process attached to the heap, as long as it was
+// translated into this process's mapping with shm_heap_ptr.
+void shm_heap_free(shm_heap* heap, void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    shm_heap_lock(heap);
+    offset_heap_free(heap->base, &shm_heap_hdr(heap)->state, ptr, NULL, NULL);
+    shm_heap_unlock(heap);
+}
@@ -0,0 +1,27 @@
+// shm_heap.h
+#ifndef SHM_HEAP_H
+#define SHM_HEAP_H
+
+#include <stddef.h>
+
+// Heap in a shared memory object that several processes map, each at its own
+// address. Blocks are linked by offset and the free list is guarded by a
+// process-shared robust mutex, so memory allocated in one process can be
+// freed in another.
+
+typedef struct shm_heap shm_heap;
+
+shm_heap* shm_heap_create(const char* name, size_t capacity);
+shm_heap* shm_heap_attach(const char* name);
+shm_heap* shm_heap_attach_fd(int fd);
+void shm_heap_detach(shm_heap* heap);
+int shm_heap_unlink(const char* name);
+int shm_heap_fd(shm_heap* heap);
+
+void* shm_heap_alloc(shm_heap* heap, size_t size);
+void shm_heap_free(shm_heap* heap, void* ptr);
+
+size_t shm_heap_offset(shm_heap* heap, const void* ptr);
+void* shm_heap_ptr(shm_heap* heap, size_t offset);
+
+#endif // SHM_HEAP_H